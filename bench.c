@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Frame-time benchmark of the front end, apart from the engines. Synthetic
+ * canvases of the given sizes are drawn in a hidden window while a script of
+ * interactions runs on each, and the percentiles of the frame times are
+ * printed, with the time spent per frame in hit-testing, in the edits
+ * themselves, in the animation sweep and in drawing:
+ *
+ *   --bench-render SIZES   CHROMPOLY_BENCH_RENDER   e.g. 1000,10000,100000
+ *
+ * The scenarios are:
+ * - idle far: the whole graph in view, nothing happening,
+ * - idle near: zoomed in at the center, nothing happening,
+ * - drag: a node dragged around in circles,
+ * - select: a click on a random node every frame,
+ * - delete: a random node deleted every frame, so that many disappear
+ *   animations run at once.
+ *
+ * Included from chrompoly.c after latency.c, for Histogram.
+ */
+#include "array.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_MAX_SIZES 8
+#define BENCH_FRAMES 240 // Per scenario
+
+typedef enum {
+  BENCH_IDLE_FAR,
+  BENCH_IDLE_NEAR,
+  BENCH_DRAG,
+  BENCH_SELECT,
+  BENCH_DELETE,
+  BENCH_SCENARIO_COUNT
+} BenchScenario;
+
+const char *bench_scenario_names[] = {"idle far", "idle near", "drag",
+                                      "select", "delete"};
+
+typedef enum {
+  BENCH_HIT_TEST,
+  BENCH_EDIT,
+  BENCH_TICK,
+  BENCH_DRAW,
+  BENCH_SECTION_COUNT
+} BenchSection;
+
+const char *bench_section_names[] = {"hit-test", "edit", "tick", "draw"};
+
+typedef struct {
+  int sizes[BENCH_MAX_SIZES]; // Node counts of the canvases
+  int size_count;             // 0 when not benchmarking
+} BenchConfig;
+
+typedef struct {
+  Histogram frames;
+  double sections[BENCH_SECTION_COUNT]; // Seconds, over all frames
+} BenchResult;
+
+/* Parse a list of sizes such as "1000,10000" into config. Returns false,
+after printing why, if it is invalid. */
+bool _bench_set_sizes(BenchConfig *config, const char *value) {
+  config->size_count = 0;
+  const char *s = value;
+  while (*s != '\0') {
+    char *end;
+    long n = strtol(s, &end, 10);
+    if (end == s || n < 1 || n > 10000000 ||
+        config->size_count == BENCH_MAX_SIZES || (*end != ',' && *end != '\0'))
+      break;
+    config->sizes[config->size_count++] = n;
+    s = *end == ',' ? end + 1 : end;
+  }
+  if (*s != '\0' || config->size_count == 0) {
+    printf("Invalid value for bench-render: %s\n", value);
+    config->size_count = 0;
+    return false;
+  }
+  return true;
+}
+
+/* Read the sizes given in the environment. Returns false, after printing
+why, if they are invalid. */
+bool bench_from_env(BenchConfig *config) {
+  config->size_count = 0;
+  const char *value = getenv("CHROMPOLY_BENCH_RENDER");
+  return value == NULL || _bench_set_sizes(config, value);
+}
+
+/* If args[0] is --bench-render, apply its value args[1] and return 2.
+Returns 0 if it is another argument, and -1, after printing why, if it is
+invalid. */
+int bench_parse_option(BenchConfig *config, int count, char **args) {
+  if (strcmp(args[0], "--bench-render") != 0)
+    return 0;
+  if (count < 2) {
+    printf("Missing value for %s\n", args[0]);
+    return -1;
+  }
+  return _bench_set_sizes(config, args[1]) ? 2 : -1;
+}
+
+/* xorshift32, so that the canvases and scripts are the same on every run */
+unsigned bench_random(unsigned *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+/*
+ * Synthetic graph with n nodes on a jittered square grid of the given
+ * spacing, centered on the origin, into xy (x0, y0, x1, y1, ...) and edges.
+ * Each node is joined to its right and lower neighbours with probability 3/4,
+ * and one in a hundred nodes also to a random node far away.
+ */
+void bench_generate(int n, int spacing, array_int *xy, array_edge *edges) {
+  unsigned state = 2463534242u;
+  int side = 1;
+  while (side * side < n)
+    side++;
+  for (int v = 0; v < n; v++) {
+    int jitter = spacing / 3;
+    array_add(xy, (v % side - side / 2) * spacing +
+                      (int)(bench_random(&state) % (2 * jitter + 1)) - jitter);
+    array_add(xy, (v / side - side / 2) * spacing +
+                      (int)(bench_random(&state) % (2 * jitter + 1)) - jitter);
+  }
+  for (int v = 0; v < n; v++) {
+    if (v % side + 1 < side && v + 1 < n && bench_random(&state) % 4 != 0)
+      array_add(edges, ((Edge){v, v + 1}));
+    if (v + side < n && bench_random(&state) % 4 != 0)
+      array_add(edges, ((Edge){v, v + side}));
+    if (bench_random(&state) % 100 == 0) {
+      int w = bench_random(&state) % n;
+      if (w != v)
+        array_add(edges, ((Edge){v, w}));
+    }
+  }
+}
+
+/* Print the results of the scenarios on a canvas of n nodes and m edges */
+void bench_print(int n, int m, BenchResult *results) {
+  printf("Render benchmark: %d nodes, %d edges, %d frames per scenario\n", n,
+         m, BENCH_FRAMES);
+  printf("%-10s %8s %8s %8s %8s  |", "ms", "p50", "p90", "p99", "max");
+  for (int i = 0; i < BENCH_SECTION_COUNT; i++)
+    printf(" %8s", bench_section_names[i]);
+  printf("\n");
+  for (int s = 0; s < BENCH_SCENARIO_COUNT; s++) {
+    Histogram *h = &results[s].frames;
+    printf("%-10s %8.2f %8.2f %8.2f %8.2f  |", bench_scenario_names[s],
+           1e3 * histogram_percentile(h, 50), 1e3 * histogram_percentile(h, 90),
+           1e3 * histogram_percentile(h, 99), h->max / 1e3);
+    // Mean per frame
+    for (int i = 0; i < BENCH_SECTION_COUNT; i++)
+      printf(" %8.3f", 1e3 * results[s].sections[i] / h->total);
+    printf("\n");
+  }
+}
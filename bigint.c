@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ */
+#include "array.h"
+#include <stdio.h>
+
+/* Arbitrary precision signed integer.
+Stored as sign + magnitude, with the magnitude in little-endian base 2^32
+limbs. Zero has no limbs and is never negative. */
+typedef struct {
+  bool neg;
+  array_32 limbs;
+} BigInt;
+
+void bigint_init(BigInt *a) {
+  a->neg = false;
+  array_init(&a->limbs);
+}
+
+void bigint_term(BigInt *a) {
+  array_term(&a->limbs);
+  a->neg = false;
+}
+
+bool bigint_is_zero(BigInt *a) { return array_size(&a->limbs) == 0; }
+
+int bigint_sign(BigInt *a) {
+  if (bigint_is_zero(a))
+    return 0;
+  return a->neg ? -1 : 1;
+}
+
+/* Drop leading zero limbs so that the representation stays canonical */
+void _bigint_trim(BigInt *a) {
+  while (array_size(&a->limbs) > 0 && array_last(&a->limbs) == 0)
+    array_del_last(&a->limbs);
+  if (array_size(&a->limbs) == 0)
+    a->neg = false;
+}
+
+void _mag_set_u64(array_32 *mag, uint64_t v) {
+  array_clear(mag);
+  while (v > 0) {
+    array_add(mag, (uint32_t)v);
+    v >>= 32;
+  }
+}
+
+/* Compare magnitude with v: returns -1, 0 or 1 */
+int _mag_cmp_u64(array_32 *mag, uint64_t v) {
+  if (array_size(mag) > 2)
+    return 1;
+  uint64_t m = 0;
+  array_enumerate(mag, i, uint32_t limb) { m |= (uint64_t)limb << (32 * i); }
+  return (m > v) - (m < v);
+}
+
+void _mag_add_u64(array_32 *mag, uint64_t v) {
+  uint64_t carry = v;
+  for (size_t i = 0; carry > 0; i++) {
+    if (i == array_size(mag))
+      array_add(mag, 0);
+    uint64_t sum = (uint64_t)array_at(mag, i) + (carry & 0xFFFFFFFF);
+    array_at(mag, i) = (uint32_t)sum;
+    carry = (carry >> 32) + (sum >> 32);
+  }
+}
+
+/* Subtract v from the magnitude, which must be at least v */
+void _mag_sub_u64(array_32 *mag, uint64_t v) {
+  uint64_t borrow = v;
+  for (size_t i = 0; borrow > 0; i++) {
+    uint64_t limb = array_at(mag, i);
+    uint64_t sub = borrow & 0xFFFFFFFF;
+    borrow >>= 32;
+    if (limb < sub) {
+      limb += (uint64_t)1 << 32;
+      borrow++;
+    }
+    array_at(mag, i) = (uint32_t)(limb - sub);
+  }
+}
+
+void bigint_set_ll(BigInt *a, long long v) {
+  a->neg = v < 0;
+  // Negate in unsigned arithmetic so that LLONG_MIN does not overflow
+  _mag_set_u64(&a->limbs, v < 0 ? -(uint64_t)v : (uint64_t)v);
+  _bigint_trim(a);
+}
+
+void bigint_copy(BigInt *dest, BigInt *src) {
+  dest->neg = src->neg;
+  array_clear(&dest->limbs);
+  array_foreach(&src->limbs, uint32_t limb) { array_add(&dest->limbs, limb); }
+}
+
+void bigint_add_ll(BigInt *a, long long v) {
+  if (v == 0)
+    return;
+  bool v_neg = v < 0;
+  uint64_t mag = v_neg ? -(uint64_t)v : (uint64_t)v;
+  if (bigint_is_zero(a) || a->neg == v_neg) {
+    _mag_add_u64(&a->limbs, mag);
+    a->neg = v_neg;
+    return;
+  }
+  // Opposite signs: subtract the smaller magnitude from the larger one
+  if (_mag_cmp_u64(&a->limbs, mag) >= 0) {
+    _mag_sub_u64(&a->limbs, mag);
+  } else {
+    uint64_t m = 0;
+    array_enumerate(&a->limbs, i, uint32_t limb) {
+      m |= (uint64_t)limb << (32 * i);
+    }
+    _mag_set_u64(&a->limbs, mag - m);
+    a->neg = v_neg;
+  }
+  _bigint_trim(a);
+}
+
+void bigint_mul_ll(BigInt *a, long long m) {
+  if (m == 0) {
+    array_clear(&a->limbs);
+    a->neg = false;
+    return;
+  }
+  uint64_t mag = m < 0 ? -(uint64_t)m : (uint64_t)m;
+  unsigned __int128 carry = 0;
+  array_enumerate(&a->limbs, i, uint32_t limb) {
+    unsigned __int128 prod = (unsigned __int128)limb * mag + carry;
+    array_at(&a->limbs, i) = (uint32_t)prod;
+    carry = prod >> 32;
+  }
+  while (carry > 0) {
+    array_add(&a->limbs, (uint32_t)carry);
+    carry >>= 32;
+  }
+  if (m < 0)
+    a->neg = !a->neg;
+  _bigint_trim(a);
+}
+
+/* Compare magnitudes: returns -1, 0 or 1 */
+int _mag_cmp(array_32 *a, array_32 *b) {
+  if (array_size(a) != array_size(b))
+    return array_size(a) < array_size(b) ? -1 : 1;
+  for (int i = array_size(a) - 1; i >= 0; i--) {
+    if (array_at(a, i) != array_at(b, i))
+      return array_at(a, i) < array_at(b, i) ? -1 : 1;
+  }
+  return 0;
+}
+
+/* Add magnitude b to a, which must not be b */
+void _mag_add(array_32 *a, array_32 *b) {
+  uint64_t carry = 0;
+  for (size_t i = 0; i < array_size(b) || carry > 0; i++) {
+    if (i == array_size(a))
+      array_add(a, 0);
+    uint64_t sum = carry + array_at(a, i);
+    if (i < array_size(b))
+      sum += array_at(b, i);
+    array_at(a, i) = (uint32_t)sum;
+    carry = sum >> 32;
+  }
+}
+
+/* Subtract magnitude b from a, which must be at least b and not be b */
+void _mag_sub(array_32 *a, array_32 *b) {
+  uint64_t borrow = 0;
+  for (size_t i = 0; i < array_size(b) || borrow > 0; i++) {
+    uint64_t sub = borrow + (i < array_size(b) ? array_at(b, i) : 0);
+    uint64_t limb = array_at(a, i);
+    borrow = limb < sub;
+    array_at(a, i) = (uint32_t)(limb + (borrow << 32) - sub);
+  }
+}
+
+/* a -= b */
+void bigint_sub(BigInt *a, BigInt *b) {
+  if (bigint_is_zero(b))
+    return;
+  if (a == b) {
+    bigint_set_ll(a, 0);
+    return;
+  }
+  bool b_neg = !b->neg; // The sign of -b
+  if (bigint_is_zero(a) || a->neg == b_neg) {
+    _mag_add(&a->limbs, &b->limbs);
+    a->neg = b_neg;
+  } else if (_mag_cmp(&a->limbs, &b->limbs) >= 0) {
+    _mag_sub(&a->limbs, &b->limbs);
+  } else {
+    // |b| > |a|: a = b - a in magnitude, with the sign of -b
+    array_32 mag;
+    array_init(&mag);
+    array_foreach(&b->limbs, uint32_t limb) { array_add(&mag, limb); }
+    _mag_sub(&mag, &a->limbs);
+    array_term(&a->limbs);
+    a->limbs = mag;
+    a->neg = b_neg;
+  }
+  _bigint_trim(a);
+}
+
+double bigint_to_double(BigInt *a) {
+  double result = 0;
+  for (int i = array_size(&a->limbs) - 1; i >= 0; i--)
+    result = result * 4294967296.0 + array_at(&a->limbs, i);
+  return a->neg ? -result : result;
+}
+
+/* Decimal representation of a. The caller owns the returned string. */
+char *bigint_to_string(BigInt *a) {
+  // Each limb contributes at most 10 decimal digits
+  size_t cap = 10 * array_size(&a->limbs) + 2;
+  char *s = malloc(cap);
+  if (bigint_is_zero(a)) {
+    strcpy(s, "0");
+    return s;
+  }
+
+  // Repeatedly divide a scratch copy of the magnitude by 10^9
+  array_32 mag;
+  array_init(&mag);
+  array_foreach(&a->limbs, uint32_t limb) { array_add(&mag, limb); }
+
+  array_32 chunks; // base 10^9 digits, least significant first
+  array_init(&chunks);
+  while (array_size(&mag) > 0) {
+    uint64_t rem = 0;
+    for (int i = array_size(&mag) - 1; i >= 0; i--) {
+      uint64_t cur = (rem << 32) | array_at(&mag, i);
+      array_at(&mag, i) = (uint32_t)(cur / 1000000000);
+      rem = cur % 1000000000;
+    }
+    while (array_size(&mag) > 0 && array_last(&mag) == 0)
+      array_del_last(&mag);
+    array_add(&chunks, (uint32_t)rem);
+  }
+
+  char *p = s;
+  if (a->neg)
+    *p++ = '-';
+  p += sprintf(p, "%u", array_last(&chunks));
+  for (int i = array_size(&chunks) - 2; i >= 0; i--)
+    p += sprintf(p, "%09u", array_at(&chunks, i));
+
+  array_term(&mag);
+  array_term(&chunks);
+  return s;
+}
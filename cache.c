@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Chromatic polynomials of recently computed graphs, shared by all jobs, so
+ * that speculative work and repeated requests for the same graph are answered
+ * without running an engine.
+ *
+ * Included from chrompoly.c after scheduler.c, for GraphSnapshot.
+ */
+#include "array.h"
+#include <threads.h>
+
+#define RESULT_CACHE_SIZE 32
+
+typedef struct {
+  GraphSnapshot graph;
+  array_ll P;
+  unsigned long last_used;
+} CachedResult;
+
+typedef struct {
+  mtx_t mutex;
+  int count;
+  unsigned long clock;
+  CachedResult entries[RESULT_CACHE_SIZE];
+} ResultCache;
+
+void result_cache_init(ResultCache *cache) {
+  memset(cache, 0, sizeof(*cache));
+  mtx_init(&cache->mutex, mtx_plain);
+}
+
+void result_cache_term(ResultCache *cache) {
+  for (int i = 0; i < cache->count; i++) {
+    array_term(&cache->entries[i].graph.edges);
+    array_term(&cache->entries[i].P);
+  }
+  mtx_destroy(&cache->mutex);
+}
+
+/* If the polynomial of graph is cached, copy it into P (which must be empty)
+and return true */
+bool result_cache_get(ResultCache *cache, GraphSnapshot *graph, array_ll *P) {
+  bool found = false;
+  mtx_lock(&cache->mutex);
+  for (int i = 0; i < cache->count && !found; i++) {
+    CachedResult *entry = &cache->entries[i];
+    if (snapshot_eq(&entry->graph, graph)) {
+      array_foreach(&entry->P, long long coeff) { array_add(P, coeff); }
+      entry->last_used = ++cache->clock;
+      found = true;
+    }
+  }
+  mtx_unlock(&cache->mutex);
+  return found;
+}
+
+/* Store a copy of graph and P, evicting the least recently used entry if the
+cache is full */
+void result_cache_put(ResultCache *cache, GraphSnapshot *graph, array_ll *P) {
+  mtx_lock(&cache->mutex);
+  CachedResult *entry = NULL;
+  for (int i = 0; i < cache->count && entry == NULL; i++) {
+    if (snapshot_eq(&cache->entries[i].graph, graph))
+      entry = &cache->entries[i];
+  }
+  if (entry == NULL && cache->count < RESULT_CACHE_SIZE) {
+    entry = &cache->entries[cache->count++];
+    array_init(&entry->graph.edges);
+    array_init(&entry->P);
+  }
+  if (entry == NULL) {
+    entry = &cache->entries[0];
+    for (int i = 1; i < cache->count; i++) {
+      if (cache->entries[i].last_used < entry->last_used)
+        entry = &cache->entries[i];
+    }
+  }
+  snapshot_copy(&entry->graph, graph);
+  array_clear(&entry->P);
+  array_foreach(P, long long coeff) { array_add(&entry->P, coeff); }
+  entry->last_used = ++cache->clock;
+  mtx_unlock(&cache->mutex);
+}
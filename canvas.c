@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * The graph drawn on the canvas.
+ * Nodes live in a slot map: a node keeps its slot from creation until its
+ * disappear animation has finished, and is referred to by a NodeId, which
+ * pairs the slot with the generation of the slot. Freeing a slot bumps its
+ * generation, so stale ids are detected instead of silently pointing at
+ * another node. Edges store NodeIds, so deleting a node never renumbers
+ * anything, and looking up an endpoint is O(1).
+ *
+ * The engines want vertices numbered 0..n-1. That numbering is a compact view
+ * of the active nodes (those not marked deleted) in slot order, rebuilt only
+ * when the set of active nodes changes.
+ *
+ * Every change that affects drawing bumps the revision, so that renderers can
+ * tell in O(1) that nothing changed since the last frame.
+ *
+ * Included from chrompoly.c after scheduler.c, for GraphSnapshot.
+ */
+#include "array.h"
+
+typedef struct {
+  int slot;
+  unsigned int generation;
+} NodeId;
+
+array_def(NodeId, node_id);
+
+#define NODE_ID_NONE ((NodeId){-1, 0})
+
+bool node_id_eq(NodeId a, NodeId b) {
+  return a.slot == b.slot && a.generation == b.generation;
+}
+
+/* A vertex but with extra fields for rendering purposes */
+typedef struct {
+  int x;
+  int y;
+  bool selected;
+  bool deleted;
+  int plop_animation_timer;
+  int disappear_animation_timer;
+} Node;
+array_def(Node, node);
+
+typedef struct {
+  NodeId start;
+  NodeId end;
+} CanvasEdge;
+array_def(CanvasEdge, canvas_edge);
+
+array_def(bool, bool);
+
+typedef struct {
+  array_node nodes;       // Indexed by slot, free slots included
+  array_bool occupied;    // Indexed by slot
+  array_uint generations; // Indexed by slot
+  array_int free_slots;
+  array_canvas_edge edges;
+  array_int animating; // Slots whose plop or disappear animation is running
+  unsigned long revision;
+
+  bool view_dirty;
+  array_int active_slots; // Vertex number -> slot
+  array_int vertex_of;    // Slot -> vertex number, or -1 if not active
+} Canvas;
+
+void canvas_init(Canvas *c) {
+  memset(c, 0, sizeof(*c));
+  c->view_dirty = true;
+}
+
+void canvas_term(Canvas *c) {
+  array_term(&c->nodes);
+  array_term(&c->occupied);
+  array_term(&c->generations);
+  array_term(&c->free_slots);
+  array_term(&c->edges);
+  array_term(&c->animating);
+  array_term(&c->active_slots);
+  array_term(&c->vertex_of);
+}
+
+int canvas_slot_count(Canvas *c) { return array_size(&c->nodes); }
+
+bool canvas_slot_occupied(Canvas *c, int slot) {
+  return array_at(&c->occupied, slot);
+}
+
+NodeId canvas_id_of_slot(Canvas *c, int slot) {
+  return (NodeId){slot, array_at(&c->generations, slot)};
+}
+
+bool canvas_valid(Canvas *c, NodeId id) {
+  return id.slot >= 0 && id.slot < canvas_slot_count(c) &&
+         array_at(&c->occupied, id.slot) &&
+         array_at(&c->generations, id.slot) == id.generation;
+}
+
+/* The node with the given id, or NULL if it no longer exists */
+Node *canvas_node(Canvas *c, NodeId id) {
+  return canvas_valid(c, id) ? &array_at(&c->nodes, id.slot) : NULL;
+}
+
+NodeId canvas_add_node(Canvas *c, Node node) {
+  int slot;
+  if (array_size(&c->free_slots) > 0) {
+    slot = array_last(&c->free_slots);
+    array_del_last(&c->free_slots);
+    array_at(&c->nodes, slot) = node;
+  } else {
+    slot = array_size(&c->nodes);
+    array_add(&c->nodes, node);
+    array_add(&c->occupied, false);
+    array_add(&c->generations, 0);
+  }
+  array_at(&c->occupied, slot) = true;
+  if (node.plop_animation_timer > 0)
+    array_add(&c->animating, slot);
+  c->view_dirty = true;
+  c->revision++;
+  return canvas_id_of_slot(c, slot);
+}
+
+void _start_animating(Canvas *c, int slot) {
+  array_foreach(&c->animating, int animating) {
+    if (animating == slot)
+      return;
+  }
+  array_add(&c->animating, slot);
+}
+
+/* Mark node as deleted and remove the edges to/from it. The node stays in
+its slot until its disappear animation has finished in canvas_tick(). */
+void canvas_mark_deleted(Canvas *c, NodeId id) {
+  Node *node = canvas_node(c, id);
+  if (node == NULL)
+    return;
+  node->deleted = true;
+  array_enumerate(&c->edges, i, CanvasEdge edge) {
+    if (node_id_eq(edge.start, id) || node_id_eq(edge.end, id)) {
+      array_del_unordered(&c->edges, i);
+      i--;
+    }
+  }
+  _start_animating(c, id.slot);
+  c->view_dirty = true;
+  c->revision++;
+}
+
+void canvas_free_node(Canvas *c, NodeId id) {
+  if (!canvas_valid(c, id))
+    return;
+  array_at(&c->occupied, id.slot) = false;
+  array_at(&c->generations, id.slot)++;
+  array_add(&c->free_slots, id.slot);
+  c->revision++;
+}
+
+/* Adds edge if the pair (a, b) does not appear in an existing edge. Returns
+whether it was added. */
+bool canvas_add_edge(Canvas *c, NodeId a, NodeId b) {
+  array_foreach(&c->edges, CanvasEdge edge) {
+    if ((node_id_eq(edge.start, a) && node_id_eq(edge.end, b)) ||
+        (node_id_eq(edge.start, b) && node_id_eq(edge.end, a)))
+      return false;
+  }
+  array_add(&c->edges, ((CanvasEdge){a, b}));
+  c->revision++;
+  return true;
+}
+
+/* Adds edge without checking for an existing one, for callers that know it
+is new, e.g. when importing a graph */
+void canvas_append_edge(Canvas *c, NodeId a, NodeId b) {
+  array_add(&c->edges, ((CanvasEdge){a, b}));
+  c->revision++;
+}
+
+void canvas_move_node(Canvas *c, NodeId id, int x, int y) {
+  Node *node = canvas_node(c, id);
+  if (node == NULL || (node->x == x && node->y == y))
+    return;
+  node->x = x;
+  node->y = y;
+  c->revision++;
+}
+
+void canvas_set_selected(Canvas *c, NodeId id, bool selected) {
+  Node *node = canvas_node(c, id);
+  if (node == NULL)
+    return;
+  node->selected = selected;
+  c->revision++;
+}
+
+void canvas_deselect_all(Canvas *c) {
+  for (int slot = 0; slot < canvas_slot_count(c); slot++)
+    array_at(&c->nodes, slot).selected = false;
+  c->revision++;
+}
+
+/* Advance the animations by one frame, and free the nodes whose disappear
+animation has finished */
+void canvas_tick(Canvas *c) {
+  array_enumerate(&c->animating, i, int slot) {
+    Node *node = &array_at(&c->nodes, slot);
+    if (node->plop_animation_timer > 0)
+      node->plop_animation_timer--;
+    if (node->deleted && node->disappear_animation_timer > 0)
+      node->disappear_animation_timer--;
+    bool done = node->deleted ? node->disappear_animation_timer <= 0
+                              : node->plop_animation_timer <= 0;
+    if (!done)
+      continue;
+    if (node->deleted)
+      canvas_free_node(c, canvas_id_of_slot(c, slot));
+    array_del_unordered(&c->animating, i);
+    i--;
+    c->revision++;
+  }
+}
+
+bool canvas_is_animating(Canvas *c, int slot) {
+  Node node = array_at(&c->nodes, slot);
+  return node.deleted || node.plop_animation_timer > 0;
+}
+
+/* Rebuild the vertex numbering of the active nodes, if it is out of date */
+void canvas_update_view(Canvas *c) {
+  if (!c->view_dirty)
+    return;
+  array_clear(&c->active_slots);
+  array_clear(&c->vertex_of);
+  for (int slot = 0; slot < canvas_slot_count(c); slot++) {
+    bool active = canvas_slot_occupied(c, slot) &&
+                  !array_at(&c->nodes, slot).deleted;
+    array_add(&c->vertex_of, active ? (int)array_size(&c->active_slots) : -1);
+    if (active)
+      array_add(&c->active_slots, slot);
+  }
+  c->view_dirty = false;
+}
+
+/* Count number of nodes not marked deleted */
+int canvas_active_count(Canvas *c) {
+  canvas_update_view(c);
+  return array_size(&c->active_slots);
+}
+
+/*
+ * Snapshot of the subgraph induced by the active nodes for which include
+ * returns true (or all of them if include is NULL), numbered in slot order.
+ */
+GraphSnapshot canvas_snapshot_where(Canvas *c,
+                                    bool (*include)(Canvas *, int, void *),
+                                    void *arg) {
+  canvas_update_view(c);
+  array_int vertex; // Slot -> vertex number in the snapshot, or -1
+  array_init(&vertex);
+  int n = 0;
+  for (int slot = 0; slot < canvas_slot_count(c); slot++) {
+    bool in = array_at(&c->vertex_of, slot) >= 0 &&
+              (include == NULL || include(c, slot, arg));
+    array_add(&vertex, in ? n++ : -1);
+  }
+  array_edge edges;
+  array_init(&edges);
+  array_foreach(&c->edges, CanvasEdge edge) {
+    int i = array_at(&vertex, edge.start.slot);
+    int j = array_at(&vertex, edge.end.slot);
+    if (i >= 0 && j >= 0)
+      array_add(&edges, ((Edge){i, j}));
+  }
+  GraphSnapshot s = snapshot_graph(n, &edges);
+  array_term(&edges);
+  array_term(&vertex);
+  return s;
+}
+
+GraphSnapshot canvas_snapshot(Canvas *c) {
+  return canvas_snapshot_where(c, NULL, NULL);
+}
+
+bool _is_selected(Canvas *c, int slot, void *arg) {
+  return array_at(&c->nodes, slot).selected;
+}
+
+bool _is_not_slot(Canvas *c, int slot, void *arg) {
+  return slot != *(int *)arg;
+}
+
+/* Snapshot of the subgraph induced by the selected nodes */
+GraphSnapshot canvas_selected_subgraph(Canvas *c) {
+  return canvas_snapshot_where(c, _is_selected, NULL);
+}
+
+/* Snapshot of the graph as it will be after deleting node id */
+GraphSnapshot canvas_snapshot_without(Canvas *c, NodeId id) {
+  return canvas_snapshot_where(c, _is_not_slot, &id.slot);
+}
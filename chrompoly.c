@@ -2,10 +2,38 @@
  * Copyright (C) 2023-2023 Way Yan Win
  * This code is under the MIT License.
  */
+// For the thread placement calls of placement.c
+#define _GNU_SOURCE
 #include "array.h"
 #include "debug.h"
+#include "trace.h"
+#include "eval.c"
+#include "poly.c"
 #include "raylib/raylib.h"
 #include "submap.c"
+#include "perf.c"
+#include "kernels.c"
+#include "planar.c"
+#include "separator.c"
+#include "delcon.c"
+#include "ordering.c"
+#include "scheduler.c"
+#include "sensitivity.c"
+#include "canvas.c"
+#include "session.c"
+#include "render.c"
+#include "view.c"
+#include "overlay.c"
+#include "polyview.c"
+#include "latency.c"
+#include "bench.c"
+#include "layout.c"
+#include "import.c"
+#include "cache.c"
+#include "savefile.c"
+#include "jobs.c"
+#include "placement.c"
+#include "spatial.c"
 #include <math.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -18,68 +46,62 @@
 #define NODE_SELECT_COLOR ORANGE
 #define NODE_DESELECT_COLOR BLACK
 
+// Seconds between updates of the progress shown while a polynomial is computed
+#define PROGRESS_INTERVAL 0.1
+#define TARGET_FPS 60
+// Computation per frame when the render loop runs the jobs itself, in seconds
+#define COOPERATIVE_BUDGET 0.004
+#define COOPERATIVE_MIN_BUDGET 0.001
+#define COOPERATIVE_GROWTH 0.0005 // Per frame on time
+#define COOPERATIVE_SHRINK 0.7    // Per late frame
+#define COOPERATIVE_MARGIN 0.002  // Left for presenting the frame
+// Frame rate while nothing moves but the progress of a computation
+#define PROGRESS_FPS 10
+
+// Rows of the polynomial when it is wrapped, which replaces the analysis text
+#define POLY_WRAPPED_ROWS 3
+#define POLY_ROW_HEIGHT 26
+// Terms scrolled per notch of the mouse wheel over the overlay
+#define POLY_WHEEL_TERMS 3
+
+#define PLOT_WIDTH 260
+#define PLOT_COLOR ((Color){0x2B, 0x6C, 0x8F, 0xFF})
+
 #define NODE_SIZE 20.0
 #define PLOP_ANIMATION_FRAMES 30.0
 #define DISAPPEAR_ANIMATION_FRAMES 30.0
 
 #define QUARTIC_EASE(x) (1.0 - pow(1.0 - x, 4))
 
-/* A vertex but with extra fields for rendering purposes */
-typedef struct {
-  int x;
-  int y;
-  bool selected;
-  bool deleted;
-  int plop_animation_timer;
-  int disappear_animation_timer;
-} Node;
-array_def(Node, node);
-
-array_node nodes;
-array_edge edges;
+// Only raylib.h is vendored: declare the GLFW function, linked into raylib,
+// that wakes a render loop waiting for events
+void glfwPostEmptyEvent(void);
 
-/* Count number of nodes not marked deleted */
-unsigned int active_node_count(array_node *nodes) {
-  unsigned int count = 0;
-  array_foreach(nodes, Node node) {
-    if (!node.deleted)
-      count++;
-  }
-  return count;
-}
+// Above this many visible nodes, the detail level draws nodes batched
+#define DETAIL_MAX_NODES 2000
+// Edge length the layout of imported graphs aims for
+#define LAYOUT_EDGE_LENGTH (4 * NODE_SIZE)
 
-/* Get the index of the ith active node in nodes */
-unsigned int get_ith_active_node_idx(array_node *nodes, unsigned int i) {
-  array_enumerate(nodes, j, Node node) {
-    if (!node.deleted)
-      i--;
-    if (i == -1)
-      return j;
-  }
-}
-
-void deselect_all_nodes(array_node *nodes) {
-  array_enumerate(nodes, i, Node node) { array_at(nodes, i).selected = false; }
-}
+Canvas canvas;
+CanvasRenderer renderer;
+View view;
+Layout layout;
+array_node_id layout_nodes; // Node of each vertex of the graph being laid out
+float *layout_positions;
+// Positions of the nodes not marked deleted, keyed by slot in canvas
+SpatialIndex node_index;
 
 /*
- * Returns the first node in `nodes` that is positioned at most NODE_SIZE
- * distance away from the coordinates (x,y),
- * or -1 if no such node was found.
+ * Returns the node that is positioned at most NODE_SIZE distance away from
+ * the coordinates (x,y), or NODE_ID_NONE if no such node was found.
  */
-int get_node_idx_at_coords(array_node *nodes, int x, int y) {
-  array_enumerate(nodes, i, Node node) {
-    int dx = node.x - x;
-    int dy = node.y - y;
-    if (!node.deleted && dx * dx + dy * dy < NODE_SIZE * NODE_SIZE) {
-      return i;
-    }
-  }
-  return -1;
+NodeId get_node_at_coords(Canvas *canvas, SpatialIndex *index, int x, int y) {
+  int slot = spatial_query_point(index, x, y, NODE_SIZE);
+  return slot >= 0 ? canvas_id_of_slot(canvas, slot) : NODE_ID_NONE;
 }
 
-void draw_node_at_idx(array_node *nodes, unsigned int i) {
-  Node node = array_at(nodes, i);
+void draw_node_at_slot(Canvas *canvas, int slot) {
+  Node node = array_at(&canvas->nodes, slot);
   Color color;
   float size;
 
@@ -101,60 +123,332 @@ void draw_node_at_idx(array_node *nodes, unsigned int i) {
   }
   // Draw the node itself
   DrawCircle(node.x, node.y, size, color);
+}
 
-  // Update animation timers
-  if (node.plop_animation_timer > 0) {
-    array_at(nodes, i).plop_animation_timer--;
+bool in_rect(Rectangle rect, float x, float y, float margin) {
+  return rect.x - margin <= x && x <= rect.x + rect.width + margin &&
+         rect.y - margin <= y && y <= rect.y + rect.height + margin;
+}
+
+int cmp_int(const void *a, const void *b) {
+  int x = *((int *)a), y = *((int *)b);
+  return (x > y) - (x < y);
+}
+
+/* Color of node in the batched renderer, or false if it is animating and
+drawn by draw_node_at_slot() every frame instead */
+bool batched_node_color(Node *node, Color *color) {
+  if (node->deleted || node->plop_animation_timer > 0)
+    return false;
+  *color = node->selected ? NODE_SELECT_COLOR : NODE_DESELECT_COLOR;
+  return true;
+}
+
+void draw_heat_map(NodeId selected);
+
+/*
+ * Draw the part of the canvas seen through view in a width x height window,
+ * with the selected node on top, and an edge being created from it to
+ * edge_end unless that is NULL. visible_slots is scratch space.
+ */
+void draw_canvas(View *view, int width, int height, NodeId selected,
+                 array_int *visible_slots, Vector2 *edge_end) {
+  Node *selected_node = canvas_node(&canvas, selected);
+  LevelOfDetail lod = view_lod(view);
+  Rectangle visible = view_visible_rect(view, width, height);
+  // Only look up the visible nodes when they are drawn one by one
+  array_clear(visible_slots);
+  if (lod == LOD_DETAIL) {
+    spatial_query_rect(&node_index, visible.x - NODE_SIZE,
+                       visible.y - NODE_SIZE,
+                       visible.x + visible.width + NODE_SIZE,
+                       visible.y + visible.height + NODE_SIZE, visible_slots);
+    if (array_size(visible_slots) > DETAIL_MAX_NODES)
+      lod = LOD_BATCHED;
+  }
+  renderer_sync(&renderer, &canvas, selected.slot, batched_node_color);
+
+  BeginMode2D(view->camera);
+
+  if (edge_end != NULL && selected_node != NULL) {
+    DrawLine(selected_node->x, selected_node->y, edge_end->x, edge_end->y,
+             DARKGRAY);
+  }
+  // Edges always come from the batched renderer, merged at far zoom
+  renderer_draw_edges(&renderer, &canvas, lod == LOD_POINTS,
+                      view->camera.zoom);
+  draw_heat_map(selected);
+  if (lod == LOD_DETAIL) {
+    // Draw the visible nodes one by one, in slot order like hit-testing,
+    // then the ones disappearing, which are no longer in node_index
+    array_sort(visible_slots, cmp_int);
+    array_foreach(visible_slots, int slot) {
+      if (slot != selected.slot)
+        draw_node_at_slot(&canvas, slot);
+    }
+    array_foreach(&canvas.animating, int slot) {
+      Node node = array_at(&canvas.nodes, slot);
+      if (node.deleted && in_rect(visible, node.x, node.y, NODE_SIZE))
+        draw_node_at_slot(&canvas, slot);
+    }
+  } else {
+    // Settled nodes come from the batched renderer. Zoomed out to points,
+    // animations are skipped: new nodes are drawn as they will end up, and
+    // deleted ones are gone at once.
+    renderer_draw_nodes(&renderer, lod == LOD_POINTS);
+    array_foreach(&canvas.animating, int slot) {
+      Node node = array_at(&canvas.nodes, slot);
+      if (slot == selected.slot || !in_rect(visible, node.x, node.y, NODE_SIZE))
+        continue;
+      if (lod == LOD_BATCHED)
+        draw_node_at_slot(&canvas, slot);
+      else if (!node.deleted)
+        DrawRectangle(node.x - NODE_SIZE, node.y - NODE_SIZE, 2 * NODE_SIZE,
+                      2 * NODE_SIZE,
+                      node.selected ? NODE_SELECT_COLOR : NODE_DESELECT_COLOR);
+    }
   }
-  if (node.deleted && node.disappear_animation_timer > 0) {
-    array_at(nodes, i).disappear_animation_timer--;
+  // Draw selected node on top
+  if (selected_node != NULL) {
+    draw_node_at_slot(&canvas, selected.slot);
   }
+
+  EndMode2D();
+}
+
+EditScheduler scheduler;
+JobPool pool;
+ResultCache result_cache;
+array_ll chromatic_polynomial;  // Result of the latest foreground job
+char on_demand_text[256];       // Result of the latest on-demand job
+// Relabeling applied to the graph before it is handed to an engine
+VertexOrdering vertex_ordering_mode = ORDERING_DEGENERACY;
+// Codepoints of the status shown instead of the polynomial, such as progress.
+// When empty, the overlay shows chromatic_polynomial through poly_view.
+array_int output;
+PolyView poly_view;
+// Bumped whenever the text of the overlay changes, which makes overlay_text
+// redraw it
+unsigned long overlay_revision = 0;
+TextCache overlay_text;
+// The latest foreground job whose polynomial was published, and when
+int result_job_id = -1;
+double result_time;
+// Edit-to-result latencies, shown with H and printed on exit
+LatencyTracker latency;
+
+#define CURVE_SAMPLES 256
+#define EVAL_POINTS 6
+
+/* Everything the overlay shows about the chromatic polynomial besides its
+coefficients. Computed by a worker thread whenever the polynomial changes.
+It is read by the render loop under results_mutex, which also guards output,
+chromatic_polynomial, poly_view, on_demand_text, overlay_revision,
+result_job_id, result_time and the heat map. */
+typedef struct {
+  bool valid;
+  array_double roots;
+  double curve_x0;
+  double curve_x1;
+  double curve[CURVE_SAMPLES]; // P sampled uniformly over [curve_x0, curve_x1]
+  char values_text[256];       // "P(1..k): ..."
+  char roots_text[256];        // "Real roots: ..."
+} PolyAnalysis;
+
+mtx_t results_mutex;
+PolyAnalysis analysis;
+
+// Heat of every single-edge edit, from the latest sensitivity job, shown over
+// the canvas until the graph is edited
+array_edge_heat heat_map;
+array_node_id heat_nodes; // Node of each vertex of the graph of the job
+int heat_job_id = -1;     // The latest sensitivity job, -1 once edited
+bool heat_shown;
+
+#define HEAT_EDGE_THICKNESS 6.0
+#define HEAT_CANDIDATE_THICKNESS 3.0
+// Sensitivity computes n(n-1)/2 minors, which already takes tens of seconds
+// for a sparse graph of this size
+#define SENSITIVITY_MAX_VERTICES 24
+
+/* Blue for an edit that hardly changes P, red for one that changes chi(G) */
+Color heat_color(float heat) {
+  Color cold = {70, 130, 180, 255}, hot = {220, 40, 30, 255};
+  return (Color){cold.r + (hot.r - cold.r) * heat,
+                 cold.g + (hot.g - cold.g) * heat,
+                 cold.b + (hot.b - cold.b) * heat, 255};
+}
+
+/* Draw the heat of removing each edge over it and, from the selected node,
+of adding each missing edge. Called inside the 2D mode of the camera. */
+void draw_heat_map(NodeId selected) {
+  mtx_lock(&results_mutex);
+  if (heat_shown) {
+    array_foreach(&heat_map, EdgeHeat heat) {
+      NodeId a = array_at(&heat_nodes, heat.u);
+      NodeId b = array_at(&heat_nodes, heat.v);
+      if (!heat.edge && !node_id_eq(a, selected) && !node_id_eq(b, selected))
+        continue;
+      // Nodes deleted since, before the edit is handed over
+      Node *start = canvas_node(&canvas, a);
+      Node *end = canvas_node(&canvas, b);
+      if (start == NULL || end == NULL || start->deleted || end->deleted)
+        continue;
+      DrawLineEx((Vector2){start->x, start->y}, (Vector2){end->x, end->y},
+                 heat.edge ? HEAT_EDGE_THICKNESS : HEAT_CANDIDATE_THICKNESS,
+                 heat_color(heat.heat));
+    }
+  }
+  mtx_unlock(&results_mutex);
+}
+
+void analyse_polynomial(array_ll *P, PolyAnalysis *result) {
+  result->roots = poly_real_roots(P);
+
+  // Exact values at the first few positive integers
+  int len = snprintf(result->values_text, sizeof(result->values_text),
+                     "P(1..%d):", EVAL_POINTS);
+  for (int k = 1; k <= EVAL_POINTS; k++) {
+    BigInt value = poly_eval_exact(P, k);
+    char *s = bigint_to_string(&value);
+    if (len < sizeof(result->values_text))
+      len += snprintf(result->values_text + len,
+                      sizeof(result->values_text) - len, k == 1 ? " %s" : ", %s",
+                      s);
+    free(s);
+    bigint_term(&value);
+  }
+
+  len = snprintf(result->roots_text, sizeof(result->roots_text), "Real roots:");
+  array_enumerate(&result->roots, i, double root) {
+    if (len < sizeof(result->roots_text))
+      len += snprintf(result->roots_text + len, sizeof(result->roots_text) - len,
+                      i == 0 ? " %.6g" : ", %.6g", root);
+  }
+
+  // Sample the curve a little past the largest real root
+  double max_root = 1.0;
+  array_foreach(&result->roots, double root) {
+    if (root > max_root)
+      max_root = root;
+  }
+  double xs[CURVE_SAMPLES];
+  result->curve_x0 = -0.5;
+  result->curve_x1 = max_root + 1.5;
+  for (int i = 0; i < CURVE_SAMPLES; i++)
+    xs[i] = result->curve_x0 +
+            (result->curve_x1 - result->curve_x0) * i / (CURVE_SAMPLES - 1);
+  poly_eval_many(P, xs, result->curve, CURVE_SAMPLES);
+  result->valid = true;
+}
+
+void invalidate_analysis() {
+  mtx_lock(&results_mutex);
+  analysis.valid = false;
+  array_term(&analysis.roots);
+  overlay_revision++;
+  mtx_unlock(&results_mutex);
 }
 
 /*
- * Adds edge if the pair (selected_idx, end_idx) does not appear in an
- * existing edge.
+ * Plot the chromatic polynomial inside area, with real roots marked on the
+ * x axis. Values grow far too quickly for a linear y axis, so the curve is
+ * drawn as asinh(P(x)), which keeps the sign and is roughly linear near 0.
  */
-void add_edge(array_edge *edges, unsigned int start_idx, unsigned int end_idx) {
-  Edge new_edge = {.start_idx = start_idx, .end_idx = end_idx};
-  if (array_size(edges) == 0) {
-    array_add(edges, new_edge);
+void draw_polynomial_plot(Rectangle area) {
+  mtx_lock(&results_mutex);
+  if (!analysis.valid) {
+    mtx_unlock(&results_mutex);
     return;
   }
-  array_foreach(edges, Edge edge) {
-    if ((edge.start_idx == start_idx && edge.end_idx == end_idx) ||
-        (edge.start_idx == end_idx && edge.end_idx == start_idx)) {
-      return;
-    }
+  double max_y = 1.0;
+  for (int i = 0; i < CURVE_SAMPLES; i++)
+    if (fabs(asinh(analysis.curve[i])) > max_y)
+      max_y = fabs(asinh(analysis.curve[i]));
+
+  double x0 = analysis.curve_x0, x1 = analysis.curve_x1;
+  float mid_y = area.y + area.height / 2;
+  float scale_x = area.width / (x1 - x0);
+  float scale_y = (area.height / 2) / max_y;
+
+  DrawLine(area.x, mid_y, area.x + area.width, mid_y, GRAY);
+  for (int k = ceil(x0); k <= x1; k++)
+    DrawLine(area.x + (k - x0) * scale_x, mid_y - 3,
+             area.x + (k - x0) * scale_x, mid_y + 3, GRAY);
+  for (int i = 1; i < CURVE_SAMPLES; i++) {
+    Vector2 a = {area.x + area.width * (i - 1) / (CURVE_SAMPLES - 1),
+                 mid_y - asinh(analysis.curve[i - 1]) * scale_y};
+    Vector2 b = {area.x + area.width * i / (CURVE_SAMPLES - 1),
+                 mid_y - asinh(analysis.curve[i]) * scale_y};
+    DrawLineEx(a, b, 2.0, PLOT_COLOR);
+  }
+  array_foreach(&analysis.roots, double root) {
+    DrawCircle(area.x + (root - x0) * scale_x, mid_y, 3.0, NODE_SELECT_COLOR);
   }
-  array_add(edges, new_edge);
+  mtx_unlock(&results_mutex);
 }
 
-void draw_edge_at_idx(array_node *nodes, array_edge *edges, unsigned int i) {
-  // The argument i ranges through all active nodes. Convert this to an index
-  // ranging over all nodes, including those marked deleted.
-  Edge edge = array_at(edges, i);
-  Node start = array_at(nodes, get_ith_active_node_idx(nodes, edge.start_idx));
-  Node end = array_at(nodes, get_ith_active_node_idx(nodes, edge.end_idx));
-  DrawLineEx((Vector2){start.x, start.y}, (Vector2){end.x, end.y}, 4.0,
-             DARKGRAY);
+/* Called with results_mutex held */
+void draw_analysis_text(Font font, Vector2 position) {
+  if (analysis.valid) {
+    DrawTextEx(font, analysis.values_text, position, 18.0, 0.0, DARKGRAY);
+    DrawTextEx(font, analysis.roots_text, (Vector2){position.x, position.y + 24},
+               18.0, 0.0, DARKGRAY);
+  }
+}
+
+/*
+ * Draw the text of the overlay, whose top left corner is at (0, y), from
+ * overlay_text. It is only laid out again when overlay_revision or the size
+ * of the overlay has changed.
+ */
+void draw_overlay_text(Font font, float y, int width, int height) {
+  mtx_lock(&results_mutex);
+  if (text_cache_begin(&overlay_text, width, height, overlay_revision)) {
+    const char *label = "Chromatic polynomial:";
+    DrawTextEx(font, label, (Vector2){10, 10}, 24.0, 0.0, BLACK);
+    Vector2 label_dims = MeasureTextEx(font, label, 24.0, 0.0);
+    Vector2 text_position = {label_dims.x + 20, 10};
+    if (array_size(&output) > 0)
+      DrawTextCodepoints(font, output.elems, array_size(&output), text_position,
+                         24.0, 0.0, DARKGRAY);
+    else
+      polyview_draw(&poly_view, &chromatic_polynomial, font, text_position,
+                    width - PLOT_WIDTH - 20 - text_position.x,
+                    POLY_WRAPPED_ROWS, POLY_ROW_HEIGHT, 24.0, DARKGRAY);
+    if (array_size(&output) > 0 || !poly_view.wrap)
+      draw_analysis_text(font, (Vector2){10, 44});
+    DrawTextEx(font, on_demand_text, (Vector2){10, 92}, 18.0, 0.0, DARKGRAY);
+    text_cache_end(&overlay_text);
+  }
+  mtx_unlock(&results_mutex);
+  text_cache_draw(&overlay_text, (Vector2){0, y});
 }
 
-mtx_t graph_changed_mutex;
-mtx_t nodes_mutex;
-array_submap all_submaps;
-array_int chromatic_polynomial;
-bool is_running = true;
-int output[1000]; // list of codepoints
-int output_len = 0;
+/* Called after publishing a result, so that the render loop draws it even
+if it is asleep waiting for input */
+void wake_render_loop() {
+  // There is no window when replaying a session
+  if (IsWindowReady())
+    glfwPostEmptyEvent();
+}
 
-void polynomial_print(array_int *P) {
+/* Replace the text shown for on-demand jobs */
+void set_on_demand_text(const char *text) {
+  mtx_lock(&results_mutex);
+  strcpy(on_demand_text, text);
+  overlay_revision++;
+  mtx_unlock(&results_mutex);
+  wake_render_loop();
+}
+
+void polynomial_print(array_ll *P) {
   for (int i = array_size(P) - 1; i >= 0; i--) {
-    int x = array_at(P, i);
+    long long x = array_at(P, i);
     if (x > 0)
-      printf("+ %dx^%d ", x, i + 1);
+      printf("+ %lldx^%d ", x, i + 1);
     else if (x < 0)
-      printf("- %dx^%d ", -x, i + 1);
+      printf("- %lldx^%d ", -x, i + 1);
   }
   printf("\n");
 }
@@ -176,19 +470,8 @@ int get_ascii_codepoint(char c) {
     return 0x2d;
 }
 
-int get_superscript_codepoint(int digit) {
-  if (digit == 0)
-    return 0x2070;
-  else if (digit == 1)
-    return 0xb9;
-  else if (digit == 2 || digit == 3)
-    return 0xb2 + (digit - 2);
-  else
-    return 0x2074 + (digit - 4);
-}
-
 void add_ascii_char_to_output(char c) {
-  output[output_len++] = get_ascii_codepoint(c);
+  array_add(&output, get_ascii_codepoint(c));
 }
 
 void add_ascii_string_to_output(char *s, int n) {
@@ -200,44 +483,38 @@ void add_number_to_output(int n) {
   int d = num_digits(n);
   for (int i = d - 1; i >= 0; i--) {
     int div = ten_pow(i);
-    output[output_len++] = 0x30 + n / div; // 0-9
+    array_add(&output, 0x30 + n / div); // 0-9
     n %= div;
   }
 }
 
-void add_superscript_number_to_output(int n) {
-  int d = num_digits(n);
-  for (int i = d - 1; i >= 0; i--) {
-    int div = ten_pow(i);
-    // Superscript 0-9
-    output[output_len++] = get_superscript_codepoint(n / div);
-    n %= div;
-  }
+/* Start over with an empty output. Called with results_mutex held, like all
+functions setting the output. */
+void _clear_output() {
+  array_clear(&output);
+  overlay_revision++;
 }
 
 void set_output_to_loading() {
-  memset(output, 0, sizeof(output));
-  output_len = 0;
+  _clear_output();
   add_ascii_string_to_output("...", 3);
 }
 
-void set_output_to_cur_submap_count() {
-  memset(output, 0, sizeof(output));
-  output_len = 0;
+void set_output_to_cur_submap_count(EngineRun *progress) {
+  _clear_output();
   // "Found <n> submaps"
   add_ascii_string_to_output("Found ", 6);
-  add_number_to_output(cur_submap_count);
+  add_number_to_output(progress->submap_count);
   add_ascii_string_to_output(" submaps", 8);
 }
 
-void set_output_to_cur_matrix_rows_count() {
-  memset(output, 0, sizeof(output));
-  output_len = 0;
+void set_output_to_cur_matrix_rows_count(EngineRun *progress) {
+  _clear_output();
   // "Processing <n>/<total> submaps"
   add_ascii_string_to_output("Processing ", 11);
-  add_number_to_output(cur_matrix_rows_count);
+  add_number_to_output(progress->matrix_rows_count);
   add_ascii_char_to_output('/');
-  add_number_to_output(array_size(&all_submaps));
+  add_number_to_output(progress->total_submap_count);
   add_ascii_string_to_output(" submaps", 8);
 }
 
@@ -257,89 +534,1055 @@ int num_digits(int n) {
   return i;
 }
 
-void set_output_to_polynomial(array_int *P) {
-  memset(output, 0, sizeof(output));
-  output_len = 0;
+/* Show P, which becomes chromatic_polynomial, from its leading term */
+void set_output_to_polynomial(array_ll *P) {
+  _clear_output();
+  polyview_reset(&poly_view, P);
+}
+
+/* ASCII rendering of P such as "x^3 - 3x^2 + 2x", for text drawn without the
+superscript glyphs of poly_view */
+void polynomial_to_string(array_ll *P, char *buf, size_t size) {
+  int len = 0;
+  buf[0] = '\0';
+  for (int power = array_size(P); power >= 1 && len < size; power--) {
+    long long coeff = array_at(P, power - 1);
+    if (coeff == 0)
+      continue;
+    const char *sign = coeff < 0 ? (len == 0 ? "-" : " - ") : (len == 0 ? "" : " + ");
+    long long abs_coeff = coeff < 0 ? -coeff : coeff;
+    len += snprintf(buf + len, size - len, "%s", sign);
+    if (abs_coeff != 1 && len < size)
+      len += snprintf(buf + len, size - len, "%lld", abs_coeff);
+    if (len < size)
+      len += snprintf(buf + len, size - len, power > 1 ? "x^%d" : "x", power);
+  }
+}
+
+typedef enum {
+  PHASE_ORDERING, // Relabeling the graph
+  PHASE_KERNEL_ENUMERATE,
+  PHASE_KERNEL_MOBIUS,
+  PHASE_SUBMAP_ENUMERATE,
+  PHASE_SUBMAP_MATRIX,
+  PHASE_SUBMAP_POLYNOMIAL,
+  PHASE_SEPARATOR_SWEEP,
+  PHASE_DELCON_EXPAND,
+  PHASE_COUNT
+} EnginePhase;
+
+const char *engine_phase_names[] = {
+    "ordering",         "kernel.enumerate", "kernel.mobius",
+    "submap.enumerate", "submap.matrix",    "submap.polynomial",
+    "separator.sweep",  "delcon.expand"};
+
+typedef enum {
+  ENGINE_KERNEL,
+  ENGINE_SUBMAP,
+  ENGINE_SEPARATOR,
+  ENGINE_DELCON
+} PolynomialEngine;
+
+/* The chromatic polynomial of a graph, being computed in steps by one of the
+engines */
+typedef struct {
+  GraphSnapshot *graph;
+  array_ll *P;
+  bool cached;   // Taken from the result cache, with nothing to compute
+  bool finished; // The engine has finished or been cancelled
+  bool keep;     // Put the result in the result cache
+  bool overflow; // Some coefficient does not fit in a long long
+  PolynomialEngine engine;
+  array_edge relabeled;
+  KernelTask kernel;
+  SubmapTask submaps;
+  SeparatorTask separator;
+  DelconTask delcon;
+  PerfPhase perf[PHASE_COUNT]; // Counters, if CHROMPOLY_PERF is set
+} PolynomialTask;
+
+/* The phase that the engine of task is in */
+EnginePhase _polynomial_phase(PolynomialTask *task) {
+  if (task->engine == ENGINE_KERNEL)
+    return PHASE_KERNEL_ENUMERATE + kernel_task_phase(&task->kernel);
+  if (task->engine == ENGINE_SEPARATOR)
+    return PHASE_SEPARATOR_SWEEP;
+  if (task->engine == ENGINE_DELCON)
+    return PHASE_DELCON_EXPAND;
+  return task->submaps.phase == SUBMAPS_ENUMERATE ? PHASE_SUBMAP_ENUMERATE
+                                                  : PHASE_SUBMAP_MATRIX;
+}
+
+/* Start computing the chromatic polynomial of graph into P, from the result
+cache if possible. graph must outlive the task, which must not be moved. */
+void polynomial_task_start(PolynomialTask *task, GraphSnapshot *graph,
+                           array_ll *P) {
+  task->graph = graph;
+  task->P = P;
+  task->keep = true;
+  task->overflow = false;
+  memset(task->perf, 0, sizeof(task->perf));
+  array_init(P);
+  array_init(&task->relabeled);
+  task->cached = result_cache_get(&result_cache, graph, P);
+  task->finished = task->cached || graph->n == 0;
+  if (task->finished)
+    return;
 
-  int degree; // The largest power of x that divides P
-  array_enumerate(P, power, int coeff) {
-    if (coeff != 0) {
-      degree = power + 1;
+  int n = graph->n;
+  for (int i = 0; i < n; i++)
+    array_add(P, 0);
+  // The polynomial does not depend on vertex labels, so the engines can
+  // work on a relabeled copy of the graph. Graphs too large for the sweep
+  // and delcon only go to the submap engine, which the labels cannot help
+  // on graphs that size, so they are left as they are.
+  TRACE_BEGIN(engine_phase_names[PHASE_ORDERING]);
+  perf_phase_begin(&task->perf[PHASE_ORDERING]);
+  VertexOrdering ordering =
+      n <= SEPARATOR_MAX_VERTICES ? vertex_ordering_mode : ORDERING_NONE;
+  array_int perm = vertex_ordering(ordering, n, &graph->edges);
+  task->relabeled = permute_edges(&graph->edges, &perm);
+  array_term(&perm);
+  // Planar graphs split along small separators, so they are likely to have a
+  // narrow sweep
+  bool sweep = n > SEPARATOR_MIN_VERTICES && n <= SEPARATOR_MAX_VERTICES &&
+               graph_is_planar(n, &task->relabeled) &&
+               separator_task_start(&task->separator, n, &task->relabeled, P);
+  perf_phase_end(&task->perf[PHASE_ORDERING]);
+  TRACE_END(engine_phase_names[PHASE_ORDERING]);
+  if (sweep) {
+    task->engine = ENGINE_SEPARATOR;
+  } else if (n <= KERNEL_MAX_VERTICES) {
+    task->engine = ENGINE_KERNEL;
+    kernel_task_start(&task->kernel, n, &task->relabeled, P);
+  } else if (n <= DELCON_MAX_VERTICES) {
+    // Sharing subgraphs through the memo table beats enumerating partitions,
+    // for any graph the sweep does not take
+    task->engine = ENGINE_DELCON;
+    delcon_task_start(&task->delcon, n, &task->relabeled, P);
+  } else {
+    task->engine = ENGINE_SUBMAP;
+    submap_task_start(&task->submaps, n, &task->relabeled);
+  }
+}
+
+/* Run the engine until it finishes or budget is used up. Returns whether it
+has finished, which includes being cancelled through run. */
+bool polynomial_task_step(PolynomialTask *task, EngineRun *run,
+                          EngineBudget *budget) {
+  while (!task->finished) {
+    EnginePhase phase = _polynomial_phase(task);
+    TRACE_BEGIN(engine_phase_names[phase]);
+    perf_phase_begin(&task->perf[phase]);
+    switch (task->engine) {
+    case ENGINE_KERNEL:
+      task->finished = kernel_task_step(&task->kernel, run, budget);
+      break;
+    case ENGINE_SUBMAP:
+      task->finished = submap_task_step(&task->submaps, run, budget);
+      break;
+    case ENGINE_SEPARATOR:
+      task->finished = separator_task_step(&task->separator, run, budget);
+      break;
+    case ENGINE_DELCON:
+      task->finished = delcon_task_step(&task->delcon, run, budget);
       break;
     }
+    perf_phase_end(&task->perf[phase]);
+    TRACE_END(engine_phase_names[phase]);
+    // The engines also return when they move on to their next phase
+    if (!task->finished && _polynomial_phase(task) == phase)
+      return false;
   }
+  return true;
+}
 
-  for (int power = array_size(P); power >= 1; power--) {
-    int coeff = array_at(P, power - 1);
-    // Sign
-    if (coeff > 0 && power < array_size(P) - 1)
-      add_ascii_char_to_output('+');
-    else if (coeff < 0)
-      add_ascii_char_to_output('-');
+/* Free the task. Returns false if it was cancelled through run, and P is then
+incomplete. P is also wrong if task->overflow is set, and is then not cached. */
+bool polynomial_task_finish(PolynomialTask *task, EngineRun *run) {
+  if (task->cached || task->graph->n == 0)
+    return true;
+  bool completed;
+  if (task->engine == ENGINE_KERNEL) {
+    completed = kernel_task_finish(&task->kernel, run);
+  } else if (task->engine == ENGINE_SEPARATOR) {
+    completed = separator_task_finish(&task->separator);
+  } else if (task->engine == ENGINE_DELCON) {
+    completed = delcon_task_finish(&task->delcon);
+    perf_phase_add(&task->perf[PHASE_DELCON_EXPAND], &task->delcon.helper_perf);
+  } else {
+    array_term(task->P);
+    TRACE_BEGIN(engine_phase_names[PHASE_SUBMAP_POLYNOMIAL]);
+    perf_phase_begin(&task->perf[PHASE_SUBMAP_POLYNOMIAL]);
+    completed = submap_task_finish(&task->submaps, task->P);
+    perf_phase_end(&task->perf[PHASE_SUBMAP_POLYNOMIAL]);
+    TRACE_END(engine_phase_names[PHASE_SUBMAP_POLYNOMIAL]);
+  }
+  array_term(&task->relabeled);
+  // polynomial_print(task->P);
+  for (int phase = 0; phase < PHASE_COUNT; phase++)
+    perf_report(&task->perf[phase], engine_phase_names[phase], task->graph->n,
+                array_size(&task->graph->edges), completed && !run->cancel);
+
+  if (!completed || run->cancel)
+    return false;
+  task->overflow = !poly_is_exact(task->P, array_size(&task->graph->edges));
+  if (task->keep && !task->overflow)
+    result_cache_put(&result_cache, task->graph, task->P);
+  return true;
+}
 
-    // Coefficient
-    if (coeff < 0)
-      coeff = -coeff;
-    if (coeff != 0 && coeff != 1)
-      add_number_to_output(coeff);
+/* P(G), then P(G / uv) for every pair of vertices u < v of G, computed one
+after the other, into the heat of every single-edge edit of G */
+typedef struct {
+  GraphSnapshot *graph;
+  int u, v; // Pair merged in minor, or u = -1 while computing P(G)
+  GraphSnapshot minor;
+  PolynomialTask task;
+  array_ll P, minor_P;
+  bool *adjacent; // Of u and v at [u * n + v]
+  int chi;
+  BigInt colourings; // P(G)(chi)
+  array_edge_heat heat;
+  bool aborted;
+  bool overflow; // Aborted as some polynomial does not fit in a long long
+} SensitivityTask;
+
+/* Start computing the heat of every edit of graph, which must outlive the
+task */
+void sensitivity_task_start(SensitivityTask *s, GraphSnapshot *graph) {
+  int n = graph->n;
+  s->graph = graph;
+  s->u = -1;
+  s->aborted = false;
+  s->overflow = false;
+  array_init(&s->minor.edges);
+  array_init(&s->heat);
+  bigint_init(&s->colourings);
+  s->adjacent = calloc((size_t)n * n + 1, sizeof(bool));
+  array_foreach(&graph->edges, Edge edge) {
+    s->adjacent[(size_t)edge.start_idx * n + edge.end_idx] = true;
+  }
+  polynomial_task_start(&s->task, graph, &s->P);
+}
 
-    // x^n
-    if (power >= degree) {
-      add_ascii_char_to_output('x');
-      if (power > 1)
-        add_superscript_number_to_output(power);
+/* Run the task until it finishes or budget is used up. Returns whether it has
+finished, which includes being cancelled through run. */
+bool sensitivity_task_step(SensitivityTask *s, EngineRun *run,
+                           EngineBudget *budget) {
+  int n = s->graph->n;
+  for (;;) {
+    if (!polynomial_task_step(&s->task, run, budget))
+      return false;
+    bool completed = polynomial_task_finish(&s->task, run);
+    if (!completed || s->task.overflow) {
+      array_term(s->u < 0 ? &s->P : &s->minor_P);
+      s->aborted = true;
+      s->overflow = completed;
+      return true;
     }
+    if (s->u < 0) {
+      s->chi = polynomial_chi(&s->P);
+      bigint_term(&s->colourings);
+      s->colourings = poly_eval_exact(&s->P, s->chi);
+      s->u = 0;
+      s->v = 0;
+    } else {
+      array_add(&s->heat,
+                edge_heat(s->u, s->v, s->adjacent[(size_t)s->u * n + s->v],
+                          &s->minor_P, s->chi, &s->colourings));
+      array_term(&s->minor_P);
+    }
+    if (++s->v == n)
+      s->v = ++s->u + 1;
+    if (s->v >= n)
+      return true;
+    array_term(&s->minor.edges);
+    s->minor = snapshot_contract(s->graph, s->u, s->v);
+    polynomial_task_start(&s->task, &s->minor, &s->minor_P);
+    // The minors would flush the graphs that the user edits out of the
+    // cache: they share their work through the memo of the delcon engine
+    s->task.keep = false;
   }
 }
 
-int calculate(void *arg) {
-  Submap submap;
-  WYMatrix M;
-  array_init(&all_submaps);
-  array_init(&chromatic_polynomial);
+/* Free the task, after moving the heat of every edit into heat, which must
+not be initialised, and returning chi(G). Returns -1 if it was cancelled or
+some polynomial overflowed. */
+int sensitivity_task_finish(SensitivityTask *s, array_edge_heat *heat) {
+  array_term(&s->P);
+  array_term(&s->minor.edges);
+  bigint_term(&s->colourings);
+  free(s->adjacent);
+  if (s->aborted) {
+    array_term(&s->heat);
+    return -1;
+  }
+  *heat = s->heat;
+  return s->chi;
+}
 
-  set_output_to_loading();
+/* The computation of a job, in steps: the polynomial of its graph, or the
+heat of every edit for JOB_SENSITIVITY */
+typedef struct {
+  Job *job;
+  PolynomialTask polynomial;
+  array_ll P;
+  SensitivityTask sensitivity;
+} JobTask;
 
-  while (is_running) {
-    if (!graph_changed)
-      continue;
+void job_task_start(JobTask *t, Job *job) {
+  t->job = job;
+  if (job->kind == JOB_SENSITIVITY)
+    sensitivity_task_start(&t->sensitivity, &job->graph);
+  else
+    polynomial_task_start(&t->polynomial, &job->graph, &t->P);
+}
+
+/* Run the job until it finishes or budget is used up. Returns whether it has
+finished, which includes being cancelled. */
+bool job_task_step(JobTask *t, EngineBudget *budget) {
+  if (t->job->kind == JOB_SENSITIVITY)
+    return sensitivity_task_step(&t->sensitivity, &t->job->run, budget);
+  return polynomial_task_step(&t->polynomial, &t->job->run, budget);
+}
+
+void publish_job_result(Job *job, array_ll *P);
+void publish_sensitivity(Job *job, int chi, array_edge_heat *heat);
+void publish_overflow(Job *job);
+
+/* Free the task, after publishing the result if the job completed. Returns
+whether it did. */
+bool job_task_finish(JobTask *t) {
+  if (t->job->kind == JOB_SENSITIVITY) {
+    array_edge_heat heat;
+    bool overflow = t->sensitivity.overflow;
+    int chi = sensitivity_task_finish(&t->sensitivity, &heat);
+    if (chi >= 0)
+      publish_sensitivity(t->job, chi, &heat);
+    else if (overflow)
+      publish_overflow(t->job);
+    return chi >= 0 || overflow;
+  }
+  bool completed = polynomial_task_finish(&t->polynomial, &t->job->run);
+  if (completed && !t->polynomial.overflow) {
+    publish_job_result(t->job, &t->P);
+  } else {
+    if (completed)
+      publish_overflow(t->job);
+    array_term(&t->P);
+  }
+  return completed;
+}
+
+/* Show the chromatic polynomial P of the graph of job as the job requires,
+and free P */
+void publish_job_result(Job *job, array_ll *P) {
+  char text[sizeof(on_demand_text)];
+  switch (job->kind) {
+  case JOB_POLYNOMIAL: {
+    // Speculative and superseded results only fill the cache
+    if (!jobs_is_current(&pool, job) || job->graph.n == 0)
+      break;
+    // Roots and samples are computed before taking the lock, and published
+    // only if no newer graph has been submitted meanwhile. P passed
+    // poly_is_exact(), see job_task_finish().
+    PolyAnalysis result;
+    analyse_polynomial(P, &result);
+    mtx_lock(&results_mutex);
+    if (jobs_is_current(&pool, job)) {
+      set_output_to_polynomial(P);
+      array_term(&analysis.roots);
+      analysis = result;
+      array_term(&chromatic_polynomial);
+      chromatic_polynomial = *P;
+      array_init(P);
+      result_job_id = job->id;
+      result_time = engine_clock();
+    } else {
+      array_term(&result.roots);
+    }
+    mtx_unlock(&results_mutex);
+    wake_render_loop();
+    break;
+  }
+  case JOB_CHROMATIC_NUMBER: {
+    snprintf(text, sizeof(text), "chi(G) = %d", polynomial_chi(P));
+    set_on_demand_text(text);
+    break;
+  }
+  case JOB_SELECTION: {
+    int len = snprintf(text, sizeof(text), "Selection: ");
+    polynomial_to_string(P, text + len, sizeof(text) - len);
+    set_on_demand_text(text);
+    break;
+  }
+  case JOB_SENSITIVITY: // Published by publish_sensitivity()
+    break;
+  }
+  array_term(P);
+}
+
+/* Show the heat of every edit of the graph of job, whose chromatic number is
+chi, and free heat */
+void publish_sensitivity(Job *job, int chi, array_edge_heat *heat) {
+  int lowering = 0, raising = 0;
+  array_foreach(heat, EdgeHeat h) {
+    lowering += h.changes_chi && h.edge;
+    raising += h.changes_chi && !h.edge;
+  }
+  char text[sizeof(on_demand_text)];
+  snprintf(text, sizeof(text),
+           "chi(G) = %d: removing %d edges lowers it, adding %d raises it",
+           chi, lowering, raising);
+  mtx_lock(&results_mutex);
+  if (job->id == heat_job_id) {
+    array_term(&heat_map);
+    heat_map = *heat;
+    heat_shown = true;
+    strcpy(on_demand_text, text);
+    overlay_revision++;
+  } else {
+    array_term(heat);
+  }
+  mtx_unlock(&results_mutex);
+  wake_render_loop();
+}
 
-    // No need to free all_submaps here, because it is already
-    // done in get_all_submaps
-    array_term(&chromatic_polynomial);
+/* Show, instead of the result of job, that the chromatic polynomial it needs
+has coefficients beyond what a long long holds */
+void publish_overflow(Job *job) {
+  const char *message = "coefficients exceed 64 bits";
+  char text[sizeof(on_demand_text)];
+  switch (job->kind) {
+  case JOB_POLYNOMIAL:
+    mtx_lock(&results_mutex);
+    if (jobs_is_current(&pool, job)) {
+      _clear_output();
+      snprintf(text, sizeof(text), "The %s", message);
+      add_ascii_string_to_output(text, strlen(text));
+      // Nor are there values, roots or a curve to show for the polynomial
+      array_clear(&chromatic_polynomial);
+      polyview_reset(&poly_view, &chromatic_polynomial);
+      array_term(&analysis.roots);
+      analysis.valid = false;
+      result_job_id = job->id;
+      result_time = engine_clock();
+    }
+    mtx_unlock(&results_mutex);
+    wake_render_loop();
+    break;
+  case JOB_CHROMATIC_NUMBER:
+    snprintf(text, sizeof(text), "chi(G): %s", message);
+    set_on_demand_text(text);
+    break;
+  case JOB_SELECTION:
+    snprintf(text, sizeof(text), "Selection: %s", message);
+    set_on_demand_text(text);
+    break;
+  case JOB_SENSITIVITY:
+    mtx_lock(&results_mutex);
+    if (job->id == heat_job_id) {
+      snprintf(on_demand_text, sizeof(on_demand_text), "Sensitivity: %s",
+               message);
+      overlay_revision++;
+    }
+    mtx_unlock(&results_mutex);
+    wake_render_loop();
+    break;
+  }
+}
 
-    mtx_lock(&graph_changed_mutex);
-    graph_changed = false;
-    mtx_unlock(&graph_changed_mutex);
+/* Time spent on jobs, by whether they completed. The time spent on cancelled
+and preempted jobs is wasted. Guarded by results_mutex. */
+typedef struct {
+  int completed, cancelled;
+  double completed_seconds, cancelled_seconds;
+} JobStats;
 
-    memset(output, 0, sizeof(output));
-    set_output_to_loading();
+JobStats job_stats;
 
-    // The actual calculation
-    mtx_lock(&nodes_mutex);
-    int n = active_node_count(&nodes);
-    mtx_unlock(&nodes_mutex);
-    if (n == 0)
+void count_job(bool completed, double seconds) {
+  mtx_lock(&results_mutex);
+  if (completed) {
+    job_stats.completed++;
+    job_stats.completed_seconds += seconds;
+  } else {
+    job_stats.cancelled++;
+    job_stats.cancelled_seconds += seconds;
+  }
+  mtx_unlock(&results_mutex);
+}
+
+/* Run by the worker threads of pool */
+void execute_job(Job *job) {
+  JobTask task;
+  EngineBudget budget = engine_unbounded();
+  double start = engine_clock();
+  job_task_start(&task, job);
+  job_task_step(&task, &budget);
+  bool completed = job_task_finish(&task);
+  count_job(completed, engine_clock() - start);
+}
+
+/*
+ * Without a spare core, a worker thread would take turns on the only core
+ * with the render loop, which then misses frames. Instead the pool has no
+ * threads, and the render loop runs its jobs itself, in steps that fit in
+ * what is left of each frame. The budget of a step shrinks when a frame is
+ * late, and grows back slowly while frames are on time.
+ */
+typedef struct {
+  Job *job; // Job being run, or NULL
+  JobTask task;
+  double seconds; // Spent on the job so far
+  double budget;  // Seconds of computation per frame
+} CooperativeRunner;
+
+void cooperative_init(CooperativeRunner *runner) {
+  runner->job = NULL;
+  runner->budget = COOPERATIVE_BUDGET;
+}
+
+/*
+ * Run the jobs of pool until the frame that started at frame_start is due,
+ * for at most the budget, which is first adapted to whether the previous
+ * frame was late. Returns whether a job is still unfinished.
+ */
+bool cooperative_run(CooperativeRunner *runner, JobPool *pool,
+                     double frame_start, bool late) {
+  double period = 1.0 / TARGET_FPS;
+  if (late)
+    runner->budget = fmax(COOPERATIVE_MIN_BUDGET,
+                          runner->budget * COOPERATIVE_SHRINK);
+  else
+    runner->budget = fmin(period, runner->budget + COOPERATIVE_GROWTH);
+  EngineBudget budget = {
+      fmin(engine_clock() + runner->budget,
+           frame_start + period - COOPERATIVE_MARGIN),
+      0};
+
+  while (engine_clock() < budget.deadline) {
+    double step_start = engine_clock();
+    if (runner->job == NULL) {
+      runner->job = jobs_take(pool);
+      if (runner->job == NULL)
+        return false;
+      runner->seconds = 0;
+      job_task_start(&runner->task, runner->job);
+    }
+    bool finished = job_task_step(&runner->task, &budget);
+    runner->seconds += engine_clock() - step_start;
+    if (!finished)
+      return true;
+    bool completed = job_task_finish(&runner->task);
+    count_job(completed, runner->seconds);
+    jobs_finish(pool, runner->job);
+    runner->job = NULL;
+  }
+  return runner->job != NULL;
+}
+
+/* Cancel the job being run, if any */
+void cooperative_term(CooperativeRunner *runner, JobPool *pool) {
+  if (runner->job == NULL)
+    return;
+  EngineBudget budget = engine_unbounded();
+  runner->job->run.cancel = true;
+  job_task_step(&runner->task, &budget);
+  job_task_finish(&runner->task);
+  jobs_finish(pool, runner->job);
+  runner->job = NULL;
+}
+
+/*
+ * How often the render loop draws a frame:
+ * - active: at the full frame rate, while something moves on the canvas or
+ *   edits wait to be handed over,
+ * - progress: at PROGRESS_FPS, while only the progress of the polynomial
+ *   changes,
+ * - idle: only when an input event arrives or a worker wakes the loop with a
+ *   result, so that an idle window costs no CPU.
+ */
+typedef enum { PACE_ACTIVE, PACE_PROGRESS, PACE_IDLE } FramePace;
+
+void set_frame_pace(FramePace *current, FramePace pace) {
+  if (pace == *current)
+    return;
+  if (pace == PACE_IDLE)
+    EnableEventWaiting();
+  else if (*current == PACE_IDLE)
+    DisableEventWaiting();
+  SetTargetFPS(pace == PACE_PROGRESS ? PROGRESS_FPS : TARGET_FPS);
+  *current = pace;
+}
+
+// Thread placement and sessions, from the environment and the command line
+PlacementConfig placement;
+SessionConfig session;
+SessionRecorder recorder;
+BenchConfig bench;
+
+/* Called by the worker and layout threads when they start */
+void start_compute_thread(const char *role) {
+  TRACE_THREAD(role);
+  placement_apply(&placement.compute, role);
+}
+
+/* Number of threads in the worker pool: as configured, or one per core.
+With a single core it is 0, and the render loop runs the jobs cooperatively. */
+int default_worker_count() {
+  if (placement.workers >= 0)
+    return placement.workers;
+  int cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 1 ? cores : 0;
+}
+
+/*
+ * Add the graph in the edge list file at path to the canvas, with its nodes
+ * scattered around the origin, and start laying it out. Returns false if the
+ * file could not be read.
+ */
+bool import_graph(const char *path) {
+  int n;
+  array_edge edges;
+  array_init(&edges);
+  if (!import_edge_list(path, &n, &edges)) {
+    array_term(&edges);
+    return false;
+  }
+  float radius = LAYOUT_EDGE_LENGTH * sqrtf(n) / 2;
+  layout_positions = malloc(2 * n * sizeof(float) + 1);
+  array_init(&layout_nodes);
+  for (int i = 0; i < n; i++) {
+    // Uniform in the disc of the given radius
+    float r = radius * sqrtf((float)rand() / RAND_MAX);
+    float angle = 2 * PI * rand() / RAND_MAX;
+    layout_positions[2 * i] = r * cosf(angle);
+    layout_positions[2 * i + 1] = r * sinf(angle);
+    Node node = {.x = layout_positions[2 * i], .y = layout_positions[2 * i + 1]};
+    NodeId id = canvas_add_node(&canvas, node);
+    spatial_insert(&node_index, id.slot, node.x, node.y);
+    array_add(&layout_nodes, id);
+  }
+  array_foreach(&edges, Edge edge) {
+    canvas_append_edge(&canvas, array_at(&layout_nodes, edge.start_idx),
+                       array_at(&layout_nodes, edge.end_idx));
+  }
+  layout_start(&layout, n, &edges, layout_positions, LAYOUT_EDGE_LENGTH,
+               pool.thread_count > 0 ? pool.thread_count : 1,
+               start_compute_thread);
+  array_term(&edges);
+  return true;
+}
+
+/*
+ * Add the graph of the canvas file at path to the canvas. If the file holds
+ * the polynomial of that very graph, it goes into the result cache, so that
+ * the first job is answered without an engine. Returns false if the file
+ * could not be read.
+ */
+bool load_canvas(const char *path, Rectangle *bounds) {
+  CanvasFile file;
+  if (!canvas_file_open(path, &file))
+    return false;
+  array_node_id ids;
+  array_init(&ids);
+  *bounds = (Rectangle){0};
+  float x1 = 0, y1 = 0;
+  for (uint64_t v = 0; v < file.node_count; v++) {
+    Node node = {.x = file.nodes[2 * v], .y = file.nodes[2 * v + 1]};
+    NodeId id = canvas_add_node(&canvas, node);
+    spatial_insert(&node_index, id.slot, node.x, node.y);
+    array_add(&ids, id);
+    if (v == 0 || node.x < bounds->x)
+      bounds->x = node.x;
+    if (v == 0 || node.y < bounds->y)
+      bounds->y = node.y;
+    if (v == 0 || node.x > x1)
+      x1 = node.x;
+    if (v == 0 || node.y > y1)
+      y1 = node.y;
+  }
+  *bounds = (Rectangle){bounds->x - NODE_SIZE, bounds->y - NODE_SIZE,
+                        x1 - bounds->x + 2 * NODE_SIZE,
+                        y1 - bounds->y + 2 * NODE_SIZE};
+  // canvas_append_edge() needs new edges, and canvas_file_edges() drops repeats
+  array_edge edges;
+  array_init(&edges);
+  canvas_file_edges(&file, &edges);
+  array_foreach(&edges, Edge edge) {
+    canvas_append_edge(&canvas, array_at(&ids, edge.start_idx),
+                       array_at(&ids, edge.end_idx));
+  }
+  array_term(&edges);
+  if (file.polynomial != NULL) {
+    GraphSnapshot graph = canvas_snapshot(&canvas);
+    if (snapshot_key(&graph) == file.key) {
+      array_ll P;
+      array_init(&P);
+      for (uint64_t i = 0; i < file.coeff_count; i++)
+        array_add(&P, file.polynomial[i]);
+      result_cache_put(&result_cache, &graph, &P);
+      array_term(&P);
+    }
+    array_term(&graph.edges);
+  }
+  array_term(&ids);
+  canvas_file_close(&file);
+  return true;
+}
+
+/* Write the graph on the canvas to the canvas file at path, with its
+polynomial if the result cache has it */
+bool save_canvas(const char *path) {
+  GraphSnapshot graph = canvas_snapshot(&canvas);
+  // The snapshot numbers the active nodes in slot order
+  array_int xy;
+  array_init(&xy);
+  array_foreach(&canvas.active_slots, int slot) {
+    array_add(&xy, array_at(&canvas.nodes, slot).x);
+    array_add(&xy, array_at(&canvas.nodes, slot).y);
+  }
+  array_ll P;
+  array_init(&P);
+  bool solved = graph.n > 0 && result_cache_get(&result_cache, &graph, &P);
+  bool ok = canvas_file_write(path, &xy, &graph.edges, solved ? &P : NULL,
+                              snapshot_key(&graph));
+  array_term(&P);
+  array_term(&xy);
+  array_term(&graph.edges);
+  return ok;
+}
+
+/* Move the imported nodes to the latest positions of the layout, except for
+dragged, which the user holds */
+void apply_layout(NodeId dragged) {
+  if (!layout_take(&layout, layout_positions))
+    return;
+  array_enumerate(&layout_nodes, i, NodeId id) {
+    Node *node = canvas_node(&canvas, id);
+    if (node == NULL || node->deleted || node_id_eq(id, dragged))
       continue;
-    submap = from_graph(n, edges);
-    all_submaps = get_all_submaps(&submap);
-    matrix_free(M);
-    M = get_ordering_matrix(&all_submaps);
-    // matrix_print(M);
-    chromatic_polynomial = get_chromatic_polynomial(n, &all_submaps, M);
-    // polynomial_print(&chromatic_polynomial);
+    int x = roundf(layout_positions[2 * i]);
+    int y = roundf(layout_positions[2 * i + 1]);
+    spatial_move(&node_index, id.slot, node->x, node->y, x, y);
+    canvas_move_node(&canvas, id, x, y);
+  }
+}
+
+/* Record the session into the file at path, starting with the graph on the
+canvas. Returns false if the file cannot be created. */
+bool start_recording(const char *path) {
+  if (!session_record_start(&recorder, path, engine_clock()))
+    return false;
+  for (int slot = 0; slot < canvas_slot_count(&canvas); slot++) {
+    Node node = array_at(&canvas.nodes, slot);
+    if (canvas_slot_occupied(&canvas, slot) && !node.deleted)
+      session_record_add_node(&recorder, recorder.start,
+                              canvas_id_of_slot(&canvas, slot), node.x, node.y);
+  }
+  array_foreach(&canvas.edges, CanvasEdge edge) {
+    session_record_add_edge(&recorder, recorder.start, edge.start, edge.end);
+  }
+  return true;
+}
+
+/* Apply a recorded edit to the canvas, where nodes holds the id of each node
+of the session */
+void _replay_edit(SessionEdit edit, array_node_id *nodes) {
+  switch (edit.kind) {
+  case EDIT_ADD_NODE:
+    array_add(nodes, canvas_add_node(&canvas, (Node){.x = edit.a, .y = edit.b}));
+    break;
+  case EDIT_ADD_EDGE: {
+    NodeId a = array_at(nodes, edit.a), b = array_at(nodes, edit.b);
+    if (canvas_valid(&canvas, a) && canvas_valid(&canvas, b))
+      canvas_add_edge(&canvas, a, b);
+    break;
+  }
+  case EDIT_DELETE_NODE:
+    // Freed by the next canvas_tick(), as it has no disappear animation
+    canvas_mark_deleted(&canvas, array_at(nodes, edit.a));
+    break;
+  }
+}
+
+/*
+ * Replay the session recorded at path without a window, at speed times its
+ * original pace. The edits go through the scheduler and the job pool as from
+ * the render loop, whose frames are emulated. Prints the latency of each edit
+ * to the first result that includes it, and the work wasted on cancelled
+ * jobs. Returns the exit status.
+ */
+int replay_session(const char *path, double speed) {
+  array_session_edit edits;
+  array_init(&edits);
+  if (!session_load(path, &edits)) {
+    array_term(&edits);
+    return 1;
+  }
+  int worker_count = default_worker_count();
+  jobs_init(&pool, worker_count, execute_job, start_compute_thread);
+  delcon_init(worker_count, start_compute_thread);
+  if (worker_count > 0 && pool.thread_count == 0)
+    return 1;
+  CooperativeRunner cooperative;
+  cooperative_init(&cooperative);
+
+  int count = array_size(&edits);
+  array_node_id nodes; // Of each node of the session, in order
+  array_init(&nodes);
+  // For each edit: the foreground job whose result includes it, when it was
+  // handed over, and its latency, or -1 until its result arrives
+  array_int edit_jobs;
+  array_double handed_over, latencies;
+  array_init(&edit_jobs);
+  array_init(&handed_over);
+  array_init(&latencies);
+  Histogram histogram = {0};
+  // Edits applied, handed over and answered
+  int applied = 0, submitted = 0, answered = 0;
+  int current_job = -1;
+  double start = engine_clock(), frame_start = start, previous_frame_start;
+  printf("%6s %10s %-8s %12s\n", "edit", "time (s)", "kind", "latency (ms)");
+  while (answered < count) {
+    previous_frame_start = frame_start;
+    frame_start = engine_clock();
+    canvas_tick(&canvas);
+    while (applied < count &&
+           array_at(&edits, applied).time <= (frame_start - start) * speed) {
+      SessionEdit edit = array_at(&edits, applied++);
+      _replay_edit(edit, &nodes);
+      scheduler_note_edit(&scheduler, start + edit.time / speed);
+      array_add(&edit_jobs, -1);
+      array_add(&handed_over, 0);
+      array_add(&latencies, -1);
+    }
+
+    if (scheduler_settled(&scheduler, frame_start, false)) {
+      GraphSnapshot handover = canvas_snapshot(&canvas);
+      // Empty graphs have no result to wait for, see publish_job_result()
+      bool empty = handover.n == 0;
+      if (scheduler_accept(&scheduler, &handover))
+        current_job =
+            jobs_submit(&pool, JOB_FOREGROUND, JOB_POLYNOMIAL, handover);
+      // Edits that cancelled out are answered by the job still current
+      for (; submitted < applied; submitted++) {
+        array_at(&edit_jobs, submitted) = empty ? -1 : current_job;
+        array_at(&handed_over, submitted) = frame_start;
+      }
+    }
+    if (pool.thread_count == 0)
+      cooperative_run(&cooperative, &pool, frame_start,
+                      frame_start - previous_frame_start > 1.25 / TARGET_FPS);
+
+    mtx_lock(&results_mutex);
+    int result_job = result_job_id;
+    double result_at = result_time;
+    mtx_unlock(&results_mutex);
+    for (int i = 0; i < submitted; i++) {
+      int job = array_at(&edit_jobs, i);
+      if (array_at(&latencies, i) >= 0 || job > result_job)
+        continue;
+      SessionEdit edit = array_at(&edits, i);
+      double latency = (job < 0 ? array_at(&handed_over, i)
+                                : fmax(result_at, array_at(&handed_over, i))) -
+                       (start + edit.time / speed);
+      array_at(&latencies, i) = latency;
+      histogram_record(&histogram, latency);
+      answered++;
+      printf("%6d %10.3f %-8s %12.2f\n", i, edit.time,
+             edit_kind_names[edit.kind], 1e3 * latency);
+    }
+
+    double wait = frame_start + 1.0 / TARGET_FPS - engine_clock();
+    if (wait > 0)
+      thrd_sleep(&(struct timespec){.tv_nsec = wait * 1e9}, NULL);
+  }
+
+  cooperative_term(&cooperative, &pool);
+  jobs_shutdown(&pool);
+  delcon_term();
+  printf("Latency of %d edits (ms): p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n",
+         count, 1e3 * histogram_percentile(&histogram, 50),
+         1e3 * histogram_percentile(&histogram, 90),
+         1e3 * histogram_percentile(&histogram, 99), histogram.max / 1e3);
+  printf("Jobs: %d completed in %.3f s, %d cancelled after %.3f s of wasted "
+         "work\n",
+         job_stats.completed, job_stats.completed_seconds, job_stats.cancelled,
+         job_stats.cancelled_seconds);
+  array_term(&edits);
+  array_term(&nodes);
+  array_term(&edit_jobs);
+  array_term(&handed_over);
+  array_term(&latencies);
+  return 0;
+}
+
+/* A random node of the canvas that is not being deleted, or NODE_ID_NONE if
+there is none */
+NodeId _bench_pick_node(unsigned *state) {
+  int slots = canvas_slot_count(&canvas);
+  for (int tries = 0; tries < 100 && slots > 0; tries++) {
+    int slot = bench_random(state) % slots;
+    if (canvas_slot_occupied(&canvas, slot) &&
+        !array_at(&canvas.nodes, slot).deleted)
+      return canvas_id_of_slot(&canvas, slot);
+  }
+  return NODE_ID_NONE;
+}
+
+/* Run one frame of scenario on the canvas, timing its sections into result */
+void _bench_frame(BenchScenario scenario, int frame, NodeId *selected,
+                  int width, int height, array_int *visible_slots,
+                  unsigned *state, BenchResult *result) {
+  double frame_start = engine_clock(), t = frame_start;
+  // Hit-test where a click would land: on a random node, or for a drag, at
+  // the node being dragged when the drag starts
+  NodeId hit = NODE_ID_NONE;
+  if (scenario >= BENCH_DRAG && (scenario != BENCH_DRAG || frame == 0)) {
+    NodeId target = _bench_pick_node(state);
+    Node *node = canvas_node(&canvas, target);
+    if (node != NULL)
+      hit = get_node_at_coords(&canvas, &node_index, node->x, node->y);
+  }
+  result->sections[BENCH_HIT_TEST] += engine_clock() - t;
+
+  t = engine_clock();
+  Node *node = canvas_node(&canvas, hit);
+  switch (scenario) {
+  case BENCH_DRAG:
+    if (node != NULL) {
+      *selected = hit;
+      canvas_deselect_all(&canvas);
+      canvas_set_selected(&canvas, hit, true);
+    }
+    node = canvas_node(&canvas, *selected);
+    if (node != NULL) {
+      // Around a circle, a few pixels per frame
+      float angle = 2 * PI * frame / 120;
+      int x = node->x + roundf(8 * cosf(angle)),
+          y = node->y + roundf(8 * sinf(angle));
+      spatial_move(&node_index, selected->slot, node->x, node->y, x, y);
+      canvas_move_node(&canvas, *selected, x, y);
+    }
+    break;
+  case BENCH_SELECT:
+    canvas_deselect_all(&canvas);
+    *selected = hit;
+    if (node != NULL)
+      canvas_set_selected(&canvas, hit, true);
+    break;
+  case BENCH_DELETE:
+    *selected = NODE_ID_NONE;
+    if (node != NULL) {
+      node->disappear_animation_timer = DISAPPEAR_ANIMATION_FRAMES;
+      spatial_remove(&node_index, hit.slot, node->x, node->y);
+      canvas_mark_deleted(&canvas, hit);
+    }
+    break;
+  default:
+    break;
+  }
+  result->sections[BENCH_EDIT] += engine_clock() - t;
+
+  t = engine_clock();
+  canvas_tick(&canvas);
+  result->sections[BENCH_TICK] += engine_clock() - t;
+
+  t = engine_clock();
+  BeginDrawing();
+  ClearBackground(BG_COLOR);
+  draw_canvas(&view, width, height, *selected, visible_slots, NULL);
+  EndDrawing();
+  result->sections[BENCH_DRAW] += engine_clock() - t;
+  histogram_record(&result->frames, engine_clock() - frame_start);
+}
+
+/* Run the render benchmark of bench.c in a hidden width x height window.
+Returns the exit status. */
+int render_benchmark(BenchConfig *config, int width, int height) {
+  SetConfigFlags(FLAG_WINDOW_HIDDEN);
+  InitWindow(width, height, "wygraph benchmark");
+  if (!IsWindowReady())
+    return 1;
+  // Draw as fast as possible
+  SetTargetFPS(0);
+  renderer_init(&renderer, NODE_SIZE, 4.0, DARKGRAY);
+  array_int visible_slots, xy;
+  array_edge edges;
+  array_node_id ids;
+  array_init(&visible_slots);
+  array_init(&xy);
+  array_init(&edges);
+  array_init(&ids);
+  BenchResult *results = malloc(BENCH_SCENARIO_COUNT * sizeof(BenchResult));
 
-    set_output_to_polynomial(&chromatic_polynomial);
+  for (int i = 0; i < config->size_count; i++) {
+    int n = config->sizes[i];
+    canvas_term(&canvas);
+    canvas_init(&canvas);
+    spatial_term(&node_index);
+    spatial_init(&node_index, 2 * NODE_SIZE);
+    array_clear(&xy);
+    array_clear(&edges);
+    array_clear(&ids);
+    int spacing = 4 * NODE_SIZE;
+    bench_generate(n, spacing, &xy, &edges);
+    for (int v = 0; v < n; v++) {
+      Node node = {.x = array_at(&xy, 2 * v), .y = array_at(&xy, 2 * v + 1)};
+      NodeId id = canvas_add_node(&canvas, node);
+      spatial_insert(&node_index, id.slot, node.x, node.y);
+      array_add(&ids, id);
+    }
+    array_foreach(&edges, Edge edge) {
+      canvas_append_edge(&canvas, array_at(&ids, edge.start_idx),
+                         array_at(&ids, edge.end_idx));
+    }
+
+    memset(results, 0, BENCH_SCENARIO_COUNT * sizeof(BenchResult));
+    unsigned state = 88172645u;
+    float half = spacing * sqrtf(n) / 2 + spacing;
+    for (int s = 0; s < BENCH_SCENARIO_COUNT; s++) {
+      view_init(&view);
+      if (s == BENCH_IDLE_FAR)
+        view_fit(&view, (Rectangle){-half, -half, 2 * half, 2 * half}, width,
+                 height);
+      else
+        view.camera.offset = (Vector2){width / 2.0, height / 2.0};
+      NodeId selected = NODE_ID_NONE;
+      canvas_deselect_all(&canvas);
+      for (int frame = 0; frame < BENCH_FRAMES; frame++)
+        _bench_frame(s, frame, &selected, width, height, &visible_slots,
+                     &state, &results[s]);
+    }
+    bench_print(n, array_size(&edges), results);
   }
+
+  free(results);
+  array_term(&visible_slots);
+  array_term(&xy);
+  array_term(&edges);
+  array_term(&ids);
+  renderer_term(&renderer);
+  CloseWindow();
   return 0;
 }
 
-int main() {
+int main(int argc, char **argv) {
   int screen_width = 1000;
   int screen_height = 600;
-  int mouse_x, mouse_y, mouse_dx, mouse_dy;
-  // -1 means that no node is selected
-  int selected_idx = -1;
+  int mouse_x, mouse_y; // In canvas coordinates
+  // Offset from the mouse to the node being dragged
+  int grab_dx = 0, grab_dy = 0;
+  // Progress of the foreground job as last shown, and when it was polled
+  EngineRun shown_progress = {0};
+  double progress_polled = 0;
+  // NODE_ID_NONE means that no node is selected
+  NodeId selected = NODE_ID_NONE;
+  // Node whose deletion was last speculatively computed
+  NodeId speculated = NODE_ID_NONE;
   const int codepoints[] = {
       0x61,   0x62,   0x63, 0x64,   0x65,   0x66,   0x67,   0x68,   0x69,
       0x6a,   0x6b,   0x6c, 0x6d,   0x6e,   0x6f,   0x70,   0x71,   0x72,
@@ -349,88 +1592,168 @@ int main() {
       0x55,   0x56,   0x57, 0x58,   0x59,   0x30,   0x31,   0x32,   0x33,
       0x34,   0x35,   0x36, 0x37,   0x38,   0x39,   0x20,   0x2e,   0x2f,
       0x3a,   0xb2,   0xb3, 0x2070, 0x00B9, 0x2074, 0x2075, 0x2076, 0x2077,
-      0x2078, 0x2079, 0x2d, 0x2b};
+      0x2078, 0x2079, 0x2d, 0x2b, 0x28,   0x29,   0x3d,   0x2c,
+      0xd7,   0x2026};
 
-  array_init(&nodes);
-  array_init(&edges);
+  // Options, then the edge list to import, if any
+  const char *import_path = NULL;
+  if (!session_from_env(&session) || !placement_from_env(&placement) ||
+      !bench_from_env(&bench) || !perf_init())
+    return 1;
+  TRACE_INIT();
+  TRACE_THREAD("ui");
+  for (int i = 1; i < argc; i++) {
+    int used = session_parse_option(&session, argc - i, argv + i);
+    if (used == 0)
+      used = bench_parse_option(&bench, argc - i, argv + i);
+    if (used == 0)
+      used = placement_parse_option(&placement, argc - i, argv + i);
+    if (used < 0)
+      return 1;
+    if (used > 0)
+      i += used - 1;
+    else
+      import_path = argv[i];
+  }
+  // Threads created from here on inherit the CPUs of the UI thread, until
+  // they apply their own placement
+  placement_apply(&placement.ui, "ui");
+
+  canvas_init(&canvas);
+  view_init(&view);
+  array_int visible_slots;
+  array_init(&visible_slots);
+  spatial_init(&node_index, 2 * NODE_SIZE);
+  array_init(&analysis.roots);
+  array_init(&chromatic_polynomial);
+  array_init(&output);
+  array_init(&heat_map);
+  array_init(&heat_nodes);
+  polyview_init(&poly_view);
+#ifndef NDEBUG
+  polyview_self_check();
+#endif
+  mtx_init(&results_mutex, mtx_plain);
+  result_cache_init(&result_cache);
+  vertex_ordering_mode =
+      parse_vertex_ordering(getenv("CHROMPOLY_ORDERING"), vertex_ordering_mode);
+  const char *quiet_ms = getenv("CHROMPOLY_QUIET_MS");
+  scheduler_init(&scheduler, quiet_ms ? atoi(quiet_ms) / 1000.0
+                                       : DEFAULT_QUIET_PERIOD);
   bool edging = false; // Is user currently creating an edge by dragging?
+  // The latest on-demand jobs for chi(G) and the selection
+  int chi_job_id = -1, selection_job_id = -1;
+  // CHROMPOLY_CONTINUOUS draws every frame, even when nothing changes
+  bool continuous = getenv("CHROMPOLY_CONTINUOUS") != NULL;
+  FramePace frame_pace = PACE_ACTIVE;
+  latency_init(&latency);
+  bool show_latency = false;
+  if (session.replay_path != NULL)
+    return replay_session(session.replay_path, session.replay_speed);
+  if (bench.size_count > 0)
+    return render_benchmark(&bench, screen_width, screen_height);
 
   InitWindow(screen_width, screen_height, "wygraph");
-  SetTargetFPS(60);
+  SetTargetFPS(TARGET_FPS);
+  renderer_init(&renderer, NODE_SIZE, 4.0, DARKGRAY);
 
   Font font = LoadFontEx("resources/Rubik-Regular.ttf", 24, codepoints,
                          sizeof(codepoints) / sizeof(int));
+  text_cache_init(&overlay_text);
 
-  thrd_t calculation_thread;
-  if (thrd_create(&calculation_thread, calculate, NULL) != thrd_success) {
-    printf("Failed to create thread\n");
+  int worker_count = default_worker_count();
+  jobs_init(&pool, worker_count, execute_job, start_compute_thread);
+  delcon_init(worker_count, start_compute_thread);
+  if (worker_count > 0 && pool.thread_count == 0)
     return 1;
+  CooperativeRunner cooperative;
+  cooperative_init(&cooperative);
+  // Start of the current and previous frames, to tell late frames
+  double frame_start = engine_clock(), previous_frame_start;
+  set_output_to_loading();
+
+  // An edge list given on the command line is imported and laid out
+  if (import_path != NULL) {
+    if (!import_graph(import_path))
+      return 1;
+    float radius = LAYOUT_EDGE_LENGTH * sqrtf(array_size(&layout_nodes)) / 2;
+    view_fit(&view, (Rectangle){-radius, -radius, 2 * radius, 2 * radius},
+             screen_width, 0.8 * screen_height);
+    scheduler_note_edit(&scheduler, engine_clock());
+  } else if (session.canvas_path != NULL &&
+             access(session.canvas_path, F_OK) == 0) {
+    // Otherwise the canvas is restored from its file, if it has one, and
+    // handed over at once
+    Rectangle bounds;
+    if (!load_canvas(session.canvas_path, &bounds))
+      return 1;
+    view_fit(&view, bounds, screen_width, 0.8 * screen_height);
+    GraphSnapshot handover = canvas_snapshot(&canvas);
+    if (handover.n > 0 && scheduler_accept(&scheduler, &handover)) {
+      int id = jobs_submit(&pool, JOB_FOREGROUND, JOB_POLYNOMIAL, handover);
+      latency_start(&latency, id, engine_clock());
+    } else if (handover.n == 0) {
+      array_term(&handover.edges);
+    }
   }
+  if (session.record_path != NULL && !start_recording(session.record_path))
+    return 1;
 
   while (!WindowShouldClose()) {
+    TRACE_BEGIN("frame");
+    previous_frame_start = frame_start;
+    frame_start = engine_clock();
     screen_width = GetScreenWidth();
     screen_height = GetScreenHeight();
-    mouse_x = GetMouseX();
-    mouse_y = GetMouseY();
-    mouse_dx = GetMouseDelta().x;
-    mouse_dy = GetMouseDelta().y;
-
-    // If node is marked deleted and its disappear animation has completed,
-    // delete it from memory.
-    array_enumerate(&nodes, i, Node node) {
-      if (node.deleted && node.disappear_animation_timer <= 0) {
-        array_del(&nodes, i);
-        if (selected_idx > i)
-          selected_idx--;
-        i--;
-      }
-    }
+    bool over_overlay = GetMouseY() >= OVERLAY_START_Y;
+    view_update(&view, !over_overlay);
+    Vector2 mouse = view_mouse(&view);
+    mouse_x = floorf(mouse.x);
+    mouse_y = floorf(mouse.y);
+
+    // Advance animations. A node marked deleted whose disappear animation has
+    // completed has its slot freed, and no other node is renumbered.
+    canvas_tick(&canvas);
+    // Take the positions from the layout of an imported graph, if any. It
+    // sets done after publishing its last positions, which are taken here.
+    bool laying_out = import_path != NULL && !layout.done;
+    apply_layout(IsMouseButtonDown(MOUSE_BUTTON_LEFT) ? selected : NODE_ID_NONE);
     // Deselect all nodes
     if (IsKeyPressed(KEY_Z)) {
-      deselect_all_nodes(&nodes);
-      selected_idx = -1;
+      canvas_deselect_all(&canvas);
+      selected = NODE_ID_NONE;
     }
     // Mark node as deleted and start disappear animation timer
     // (node is only removed from memory when the animation finishes)
-    if (IsKeyPressed(KEY_X) && selected_idx >= 0) {
-      array_at(&nodes, selected_idx).deleted = true;
-      array_at(&nodes, selected_idx).disappear_animation_timer =
-          DISAPPEAR_ANIMATION_FRAMES;
-
-      array_enumerate(&edges, i, Edge edge) {
-        // Remove edges to/from node marked deleted
-        if (edge.start_idx == selected_idx || edge.end_idx == selected_idx) {
-          mtx_lock(&nodes_mutex);
-          array_del(&edges, i);
-          mtx_unlock(&nodes_mutex);
-          i--;
-          continue;
-        }
-      }
-      array_enumerate(&edges, i, Edge edge) {
-        if (edge.start_idx > selected_idx)
-          array_at(&edges, i).start_idx--;
-        if (edge.end_idx > selected_idx)
-          array_at(&edges, i).end_idx--;
-      }
+    Node *selected_node = canvas_node(&canvas, selected);
+    if (IsKeyPressed(KEY_X) && selected_node != NULL) {
+      selected_node->disappear_animation_timer = DISAPPEAR_ANIMATION_FRAMES;
+      spatial_remove(&node_index, selected.slot, selected_node->x,
+                     selected_node->y);
+      // Also removes edges to/from node marked deleted
+      session_record_delete_node(&recorder, engine_clock(), selected);
+      canvas_mark_deleted(&canvas, selected);
 
       // Deselect all nodes
-      deselect_all_nodes(&nodes);
-      selected_idx = -1;
+      canvas_deselect_all(&canvas);
+      selected = NODE_ID_NONE;
+      speculated = NODE_ID_NONE;
 
-      // Indicate to whole program that graph has changed, so that threads
-      // can redo computation
-      mtx_lock(&graph_changed_mutex);
-      graph_changed = true;
-      mtx_unlock(&graph_changed_mutex);
+      // Indicate that the graph has changed, so that the polynomial is
+      // recomputed once the edits settle
+      scheduler_note_edit(&scheduler, engine_clock());
     }
-    // Left click creates a new node or selects an existing one
+    // Left click creates a new node or selects an existing one.
+    // Holding shift adds to the selection instead of replacing it.
     if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-      deselect_all_nodes(&nodes);
-      selected_idx = get_node_idx_at_coords(&nodes, mouse_x, mouse_y);
-      if (selected_idx >= 0) {
-        // selected_idx = get_ith_active_node_idx(&nodes, selected_idx);
-        array_at(&nodes, selected_idx).selected = true;
+      if (!IsKeyDown(KEY_LEFT_SHIFT) && !IsKeyDown(KEY_RIGHT_SHIFT))
+        canvas_deselect_all(&canvas);
+      selected = get_node_at_coords(&canvas, &node_index, mouse_x, mouse_y);
+      grab_dx = grab_dy = 0;
+      if (canvas_valid(&canvas, selected)) {
+        canvas_set_selected(&canvas, selected, true);
+        grab_dx = canvas_node(&canvas, selected)->x - mouse_x;
+        grab_dy = canvas_node(&canvas, selected)->y - mouse_y;
       } else {
         Node new_node = {.x = mouse_x,
                          .y = mouse_y,
@@ -438,91 +1761,244 @@ int main() {
                          .deleted = false,
                          .plop_animation_timer = PLOP_ANIMATION_FRAMES,
                          .disappear_animation_timer = 0};
-        array_add(&nodes, new_node);
-        selected_idx = array_size(&nodes) - 1;
-        mtx_lock(&graph_changed_mutex);
-        graph_changed = true;
-        mtx_unlock(&graph_changed_mutex);
+        selected = canvas_add_node(&canvas, new_node);
+        spatial_insert(&node_index, selected.slot, mouse_x, mouse_y);
+        speculated = NODE_ID_NONE;
+        session_record_add_node(&recorder, engine_clock(), selected, mouse_x,
+                                mouse_y);
+        scheduler_note_edit(&scheduler, engine_clock());
       }
     }
     // Hold left click to drag selected node
+    selected_node = canvas_node(&canvas, selected);
     if (IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
-      if (selected_idx >= 0) {
-        array_at(&nodes, selected_idx).x += mouse_dx;
-        array_at(&nodes, selected_idx).y += mouse_dy;
+      int x = mouse_x + grab_dx, y = mouse_y + grab_dy;
+      if (selected_node != NULL &&
+          (selected_node->x != x || selected_node->y != y)) {
+        spatial_move(&node_index, selected.slot, selected_node->x,
+                     selected_node->y, x, y);
+        canvas_move_node(&canvas, selected, x, y);
       }
     }
     // Start creating edge
-    if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT) && selected_idx >= 0) {
+    if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT) && selected_node != NULL) {
       edging = true;
     }
     // If user deselected node while creating edge
     // (e.g. by pressing 'z' or deleting it),
     // cancel edge.
-    if (edging && selected_idx < 0) {
+    if (edging && selected_node == NULL) {
       edging = false;
     }
     // Create new edge if the end point is at another node,
     // otherwise cancel the edge.
     if (IsMouseButtonReleased(MOUSE_BUTTON_RIGHT) && edging) {
-      int end_idx = get_node_idx_at_coords(&nodes, mouse_x, mouse_y);
-      if (end_idx >= 0 && selected_idx != end_idx) {
-        add_edge(&edges, selected_idx, end_idx);
-        mtx_lock(&graph_changed_mutex);
-        graph_changed = true;
-        mtx_unlock(&graph_changed_mutex);
+      NodeId end = get_node_at_coords(&canvas, &node_index, mouse_x, mouse_y);
+      if (canvas_valid(&canvas, end) && !node_id_eq(selected, end) &&
+          canvas_add_edge(&canvas, selected, end)) {
+        speculated = NODE_ID_NONE;
+        session_record_add_edge(&recorder, engine_clock(), selected, end);
+        scheduler_note_edit(&scheduler, engine_clock());
       }
       edging = false;
     }
 
-    BeginDrawing();
+    // Scroll the polynomial by terms with the arrow keys, or with the wheel
+    // over the overlay. W wraps it over several rows, and A switches between
+    // abbreviated and full coefficients.
+    int scroll = IsKeyPressed(KEY_RIGHT) - IsKeyPressed(KEY_LEFT);
+    if (over_overlay)
+      scroll -= (int)(GetMouseWheelMove() * POLY_WHEEL_TERMS);
+    bool wrap = IsKeyPressed(KEY_W), abbreviate = IsKeyPressed(KEY_A);
+    if (scroll != 0 || wrap || abbreviate) {
+      mtx_lock(&results_mutex);
+      polyview_scroll(&poly_view, scroll);
+      poly_view.wrap ^= wrap;
+      poly_view.abbreviate ^= abbreviate;
+      overlay_revision++;
+      mtx_unlock(&results_mutex);
+    }
 
-    ClearBackground(BG_COLOR);
+    if (IsKeyPressed(KEY_H))
+      show_latency = !show_latency;
+    // Write the timeline so far, if CHROMPOLY_TRACE is set
+    if (IsKeyPressed(KEY_T))
+      TRACE_WRITE();
+
+    // Compute chi(G) on demand. Asking again supersedes the previous job.
+    if (IsKeyPressed(KEY_C)) {
+      set_on_demand_text("Computing chi(G)...");
+      jobs_cancel(&pool, chi_job_id);
+      chi_job_id = jobs_submit(&pool, JOB_ON_DEMAND, JOB_CHROMATIC_NUMBER,
+                               canvas_snapshot(&canvas));
+    }
+    // Compute the polynomial of the subgraph induced by the selection
+    if (IsKeyPressed(KEY_S)) {
+      set_on_demand_text("Computing selection...");
+      jobs_cancel(&pool, selection_job_id);
+      selection_job_id = jobs_submit(&pool, JOB_ON_DEMAND, JOB_SELECTION,
+                                     canvas_selected_subgraph(&canvas));
+    }
 
-    // Draw the preview edge that user is dragging around
-    if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT) && edging) {
-      Node selected_node = array_at(&nodes, selected_idx);
-      DrawLine(selected_node.x, selected_node.y, mouse_x, mouse_y, DARKGRAY);
+    // Show how much adding or removing each single edge would change P
+    if (IsKeyPressed(KEY_E) &&
+        array_size(&canvas.active_slots) > SENSITIVITY_MAX_VERTICES) {
+      char text[sizeof(on_demand_text)];
+      snprintf(text, sizeof(text), "Sensitivity needs at most %d vertices",
+               SENSITIVITY_MAX_VERTICES);
+      set_on_demand_text(text);
+    } else if (IsKeyPressed(KEY_E)) {
+      set_on_demand_text("Computing sensitivity...");
+      GraphSnapshot graph = canvas_snapshot(&canvas);
+      mtx_lock(&results_mutex);
+      heat_shown = false;
+      jobs_cancel(&pool, heat_job_id);
+      array_clear(&heat_nodes);
+      array_foreach(&canvas.active_slots, int slot) {
+        array_add(&heat_nodes, canvas_id_of_slot(&canvas, slot));
+      }
+      heat_job_id = jobs_submit(&pool, JOB_ON_DEMAND, JOB_SENSITIVITY, graph);
+      mtx_unlock(&results_mutex);
     }
-    // Draw edges
-    array_enumerate(&edges, i, Edge edge) {
-      draw_edge_at_idx(&nodes, &edges, i);
+
+    // Hand the graph over once the burst of edits is over
+    if (scheduler_settled(&scheduler, engine_clock(),
+                          IsMouseButtonDown(MOUSE_BUTTON_LEFT) ||
+                              IsMouseButtonDown(MOUSE_BUTTON_RIGHT))) {
+      GraphSnapshot handover = canvas_snapshot(&canvas);
+      if (scheduler_accept(&scheduler, &handover)) {
+        mtx_lock(&results_mutex);
+        set_output_to_loading();
+        // The heat map, and the job computing it, are of the graph before
+        heat_shown = false;
+        jobs_cancel(&pool, heat_job_id);
+        heat_job_id = -1;
+        mtx_unlock(&results_mutex);
+        shown_progress = (EngineRun){0};
+        invalidate_analysis();
+        int id = jobs_submit(&pool, JOB_FOREGROUND, JOB_POLYNOMIAL, handover);
+        latency_start(&latency, id, scheduler.first_edit_time);
+      }
     }
-    // Draw deselected nodes first
-    array_enumerate(&nodes, i, Node node) {
-      if (i != selected_idx) {
-        draw_node_at_idx(&nodes, i);
+    // While a node is selected, speculatively compute the graph without it,
+    // so that deleting it shows the new polynomial immediately
+    if (selected_node != NULL && !node_id_eq(selected, speculated) &&
+        !selected_node->deleted) {
+      jobs_submit(&pool, JOB_BACKGROUND, JOB_POLYNOMIAL,
+                  canvas_snapshot_without(&canvas, selected));
+      speculated = selected;
+    }
+
+    BeginDrawing();
+
+    ClearBackground(BG_COLOR);
+
+    // Preview the edge that the user is dragging around
+    Vector2 edge_end = {mouse_x, mouse_y};
+    draw_canvas(&view, screen_width, screen_height, selected, &visible_slots,
+                IsMouseButtonDown(MOUSE_BUTTON_RIGHT) && edging ? &edge_end
+                                                                : NULL);
+
+    // Show the progress of the foreground job a few times per second, and
+    // only when the counts have moved
+    EngineRun progress;
+    if (GetTime() - progress_polled >= PROGRESS_INTERVAL) {
+      progress_polled = GetTime();
+      mtx_lock(&results_mutex);
+      if (jobs_foreground_progress(&pool, &progress) &&
+          (progress.submap_count != shown_progress.submap_count ||
+           progress.matrix_rows_count != shown_progress.matrix_rows_count)) {
+        if (progress.submap_count > 0 && progress.matrix_rows_count == 0)
+          set_output_to_cur_submap_count(&progress);
+        else if (progress.matrix_rows_count > 0)
+          set_output_to_cur_matrix_rows_count(&progress);
+        shown_progress = progress;
+        latency_reach(&latency, LATENCY_PROGRESS, engine_clock());
       }
+      mtx_unlock(&results_mutex);
     }
-    // Draw selected node on top
-    if (selected_idx >= 0) {
-      draw_node_at_idx(&nodes, selected_idx);
+    // Time the edits being measured to their result, drawn in this frame
+    bool result_drawn = false;
+    if (latency_pending(&latency, LATENCY_RESULT)) {
+      mtx_lock(&results_mutex);
+      if (result_job_id == latency.job_id) {
+        latency_reach(&latency, LATENCY_RESULT, result_time);
+        result_drawn = true;
+      }
+      mtx_unlock(&results_mutex);
     }
 
     DrawRectangle(0, OVERLAY_START_Y, screen_width, screen_height, OVERLAY_COLOR);
-    DrawTextEx(font,
-               "Chromatic polynomial:", (Vector2){10, OVERLAY_START_Y+10},
-               24.0, 0.0, BLACK);
-    if (cur_submap_count > 0 && cur_matrix_rows_count == 0)
-      set_output_to_cur_submap_count();
-    else if (cur_matrix_rows_count > 0)
-      set_output_to_cur_matrix_rows_count();
-    Vector2 CP_text_dims = MeasureTextEx(font, "Chromatic polynomial:", 24.0, 0.0);
-    DrawTextCodepoints(font, output, output_len,
-                       (Vector2){CP_text_dims.x+20, OVERLAY_START_Y+10}, 24.0, 0.0,
-                       DARKGRAY);
+    draw_overlay_text(font, OVERLAY_START_Y, screen_width,
+                      screen_height - OVERLAY_START_Y);
+    draw_polynomial_plot((Rectangle){screen_width - PLOT_WIDTH - 10,
+                                     OVERLAY_START_Y + 10, PLOT_WIDTH,
+                                     screen_height - OVERLAY_START_Y - 20});
+    if (show_latency) {
+      DrawRectangle(screen_width - 420, 0, 420, 70, OVERLAY_COLOR);
+      latency_draw(&latency, font, (Vector2){screen_width - 410, 8}, 16.0);
+    }
+
+    // Without worker threads, compute in what is left of the frame
+    bool cooperating = false;
+    if (pool.thread_count == 0) {
+      bool late = frame_pace == PACE_ACTIVE &&
+                  frame_start - previous_frame_start > 1.25 / TARGET_FPS;
+      TRACE_BEGIN("cooperative");
+      cooperating = cooperative_run(&cooperative, &pool, frame_start, late);
+      TRACE_END("cooperative");
+    }
 
+    // EndDrawing() sleeps until the next frame is due, or until an event
+    // arrives when idle
+    if (!continuous) {
+      FramePace pace = PACE_IDLE;
+      if (array_size(&canvas.animating) > 0 || laying_out || scheduler.dirty ||
+          cooperating)
+        pace = PACE_ACTIVE;
+      else if (jobs_foreground_progress(&pool, &progress))
+        pace = PACE_PROGRESS;
+      set_frame_pace(&frame_pace, pace);
+    }
+
+    TRACE_END("frame");
+    // Includes waiting for the next frame, or for an event
+    TRACE_BEGIN("present");
     EndDrawing();
+    TRACE_END("present");
+    if (result_drawn)
+      latency_reach(&latency, LATENCY_SHOWN, engine_clock());
   }
 
-  is_running = false;
-  if (thrd_join(calculation_thread, NULL) != thrd_success) {
-    printf("Error joining thread\n");
-    return 1;
+  cooperative_term(&cooperative, &pool);
+  jobs_shutdown(&pool);
+  delcon_term();
+  if (session.canvas_path != NULL)
+    save_canvas(session.canvas_path);
+  perf_term();
+  session_record_stop(&recorder);
+  latency_print(&latency, stdout);
+  if (import_path != NULL) {
+    layout_term(&layout);
+    array_term(&layout_nodes);
+    free(layout_positions);
   }
-  free_submaps(&all_submaps);
+  TRACE_WRITE();
+  TRACE_TERM();
   array_term(&chromatic_polynomial);
+  array_term(&output);
+  array_term(&heat_map);
+  array_term(&heat_nodes);
+  polyview_term(&poly_view);
+  array_term(&analysis.roots);
+  scheduler_term(&scheduler);
+  result_cache_term(&result_cache);
+  spatial_term(&node_index);
+  canvas_term(&canvas);
+  renderer_term(&renderer);
+  text_cache_term(&overlay_text);
+  array_term(&visible_slots);
 
   CloseWindow();
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,698 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Deletion-contraction engine, run by a team of threads that steal work from
+ * each other. For any edge e, P(G) = P(G - e) - P(G / e), and this expands
+ * into a large, irregular tree of graphs, many of which appear several times.
+ *
+ * Before a graph is split, every simplicial vertex (whose k neighbours form a
+ * clique) is removed, multiplying P by x - k: this removes isolated vertices,
+ * leaves, and whole chordal graphs at once. Above the grain size, both graphs
+ * of a split are pushed as tasks, and the last of the two to be computed
+ * computes their parent, so that no thread ever waits for another. Each thread
+ * pushes and pops tasks at the bottom of its own deque and, when it runs out,
+ * steals from the top of the deque of another thread, which holds the largest
+ * graphs. Below the grain size, a thread expands the graph itself, also
+ * splitting it into its components and at its cut vertices. The thread that
+ * steps a task is helped by a team of threads started once by delcon_init()
+ * and shared by every task.
+ *
+ * Every graph is looked up in a memo table shared by all threads and kept
+ * between computations. Graphs are relabeled by degree, so that more of the
+ * equal graphs reached along different branches have equal keys. The table is
+ * lock-free: each entry has a version that is odd while a thread writes it,
+ * and readers skip it if the version changed under them. It has a fixed size,
+ * and a new result only evicts the cheapest of the entries it may go in, by
+ * the number of graphs that computing them took, and only if it cost more;
+ * otherwise the cost of that entry is halved, so that stale results age out.
+ *
+ * Coefficients are computed modulo 2^64, which is exact for every result that
+ * array_int can hold.
+ *
+ * Included from chrompoly.c after kernels.c, for _mix64() and the engine types,
+ * poly.c, for the polynomial arithmetic, and perf.c, for PerfPhase.
+ */
+#include "array.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#define DELCON_MAX_VERTICES 64 // One bit per vertex in an adjacency word
+#define DELCON_GRAIN 10        // Tasks with at most this many edges beyond n
+#define DELCON_DEQUE_SIZE 4096 // More than the deepest branch can push
+#define DELCON_MEMO_ENTRIES (1 << 16)
+#define DELCON_MEMO_WAYS 4          // Entries a graph may be stored in
+#define DELCON_MEMO_MAX_VERTICES 32 // Larger graphs are not stored
+#define DELCON_MEMO_MIN_COST 2      // Cheaper results are not stored
+
+
+typedef struct {
+  int n;
+  uint64_t adj[DELCON_MAX_VERTICES]; // Neighbours of each vertex
+} DelconGraph;
+
+typedef struct DelconNode DelconNode;
+
+/* A graph of the expansion, whose polynomial is computed from those of its
+deletion and contraction, then handed to its parent */
+struct DelconNode {
+  DelconGraph graph; // Reduced once expanded
+  DelconNode *parent; // NULL for the whole graph
+  int branch;         // Of parent: 0 for the deletion, 1 for the contraction
+  int removed;        // Simplicial vertices removed by the reduction
+  int k[DELCON_MAX_VERTICES]; // Neighbours of each when it was removed
+  uint64_t key[2];
+  atomic_int waiting; // Branches not computed yet
+  unsigned cost[2];   // Graphs that each branch took
+  uint64_t branch_P[2][DELCON_MAX_VERTICES + 1];
+};
+
+typedef struct {
+  // Chase-Lev deque: the owner pushes and pops at bottom, thieves take from
+  // top
+  atomic_long top, bottom;
+  _Atomic(DelconNode *) nodes[DELCON_DEQUE_SIZE];
+  uint64_t seed; // For choosing whom to steal from
+} DelconWorker;
+
+typedef struct {
+  int n;
+  array_ll *P;
+  int thread_count; // Deques: one for the calling thread, one per helper
+  DelconWorker *workers;
+  atomic_bool done; // The whole graph is computed, into result
+  atomic_bool stop; // Cancelled: every thread returns
+  uint64_t result[DELCON_MAX_VERTICES + 1];
+  EngineRun *run;
+  // Guarded by delcon_team.mutex
+  int joined;  // Helpers that have joined, each with the next deque
+  int helping; // Helpers that have not left yet
+  PerfPhase helper_perf; // Counters of the helpers, summed
+} DelconTask;
+
+/* Helper threads shared by every task, each of which joins a task stepping
+without a budget while fewer than size threads are busy, counting the thread
+stepping each task. So jobs running at once share the cores instead of each
+bringing its own helpers. */
+typedef struct {
+  mtx_t mutex;
+  cnd_t changed; // A task was started or left, or the team shuts down
+  array_ptr tasks; // Tasks that helpers may join
+  int busy;
+  int size;
+  int thread_count;
+  thrd_t *threads;
+  void (*thread_start)(const char *role); // May be NULL
+  bool shutdown;
+} DelconTeam;
+
+DelconTeam delcon_team;
+
+typedef struct {
+  atomic_uint version; // Odd while a thread writes the entry
+  atomic_uint cost;    // 0 if the entry is empty
+  atomic_ullong key[2];
+  atomic_ullong coeffs[DELCON_MEMO_MAX_VERTICES + 1];
+} DelconEntry;
+
+DelconEntry *delcon_memo;
+once_flag delcon_memo_once = ONCE_FLAG_INIT;
+
+void _delcon_memo_init() {
+  delcon_memo = calloc(DELCON_MEMO_ENTRIES, sizeof(DelconEntry));
+}
+
+/* Two independent hashes of g, so that distinct graphs practically never
+share a key */
+void _delcon_key(DelconGraph *g, uint64_t key[2]) {
+  key[0] = _mix64(g->n + 0x9e3779b97f4a7c15ULL);
+  key[1] = _mix64(g->n + 0xc2b2ae3d27d4eb4fULL);
+  for (int v = 0; v < g->n; v++) {
+    key[0] = _mix64(key[0] ^ g->adj[v]);
+    key[1] = _mix64(key[1] + g->adj[v] * 0xff51afd7ed558ccdULL);
+  }
+}
+
+/* Copy the polynomial of the graph with n vertices and key into P, and
+return true, if the memo table has it. Otherwise P may have been written. */
+bool _delcon_memo_get(uint64_t key[2], int n, uint64_t *P) {
+  if (n > DELCON_MEMO_MAX_VERTICES)
+    return false;
+  for (int way = 0; way < DELCON_MEMO_WAYS; way++) {
+    DelconEntry *e =
+        &delcon_memo[(key[0] + way) & (DELCON_MEMO_ENTRIES - 1)];
+    unsigned version = atomic_load_explicit(&e->version, memory_order_acquire);
+    if (version & 1 ||
+        atomic_load_explicit(&e->key[0], memory_order_relaxed) != key[0] ||
+        atomic_load_explicit(&e->key[1], memory_order_relaxed) != key[1] ||
+        atomic_load_explicit(&e->cost, memory_order_relaxed) == 0)
+      continue;
+    for (int i = 0; i <= n; i++)
+      P[i] = atomic_load_explicit(&e->coeffs[i], memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&e->version, memory_order_relaxed) == version)
+      return true;
+  }
+  return false;
+}
+
+/* Store the polynomial P of the graph with n vertices and key, which took
+cost graphs to compute, in place of the cheapest entry it may go in */
+void _delcon_memo_put(uint64_t key[2], int n, uint64_t *P, unsigned cost) {
+  if (n > DELCON_MEMO_MAX_VERTICES || cost < DELCON_MEMO_MIN_COST)
+    return;
+  DelconEntry *victim = NULL;
+  unsigned victim_cost = 0;
+  for (int way = 0; way < DELCON_MEMO_WAYS; way++) {
+    DelconEntry *e =
+        &delcon_memo[(key[0] + way) & (DELCON_MEMO_ENTRIES - 1)];
+    unsigned c = atomic_load_explicit(&e->cost, memory_order_relaxed);
+    if (c != 0 &&
+        atomic_load_explicit(&e->key[0], memory_order_relaxed) == key[0] &&
+        atomic_load_explicit(&e->key[1], memory_order_relaxed) == key[1])
+      return;
+    if (victim == NULL || c < victim_cost) {
+      victim = e;
+      victim_cost = c;
+    }
+  }
+  if (victim_cost >= cost) {
+    atomic_store_explicit(&victim->cost, victim_cost / 2,
+                          memory_order_relaxed);
+    return;
+  }
+  unsigned version =
+      atomic_load_explicit(&victim->version, memory_order_relaxed);
+  if (version & 1 || !atomic_compare_exchange_strong_explicit(
+                         &victim->version, &version, version + 1,
+                         memory_order_acquire, memory_order_relaxed))
+    return; // Another thread is writing it
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&victim->key[0], key[0], memory_order_relaxed);
+  atomic_store_explicit(&victim->key[1], key[1], memory_order_relaxed);
+  atomic_store_explicit(&victim->cost, cost, memory_order_relaxed);
+  for (int i = 0; i <= n; i++)
+    atomic_store_explicit(&victim->coeffs[i], P[i], memory_order_relaxed);
+  atomic_store_explicit(&victim->version, version + 2, memory_order_release);
+}
+
+/* Keep the vertices of g in alive, relabeled by increasing degree */
+void _delcon_relabel(DelconGraph *g, uint64_t alive) {
+  int count[DELCON_MAX_VERTICES + 1] = {0}, label[DELCON_MAX_VERTICES];
+  int n = 0;
+  for (uint64_t rest = alive; rest; rest &= rest - 1) {
+    int v = __builtin_ctzll(rest);
+    g->adj[v] &= alive;
+    count[__builtin_popcountll(g->adj[v]) + 1]++;
+    n++;
+  }
+  for (int d = 1; d <= DELCON_MAX_VERTICES; d++)
+    count[d] += count[d - 1];
+  for (uint64_t rest = alive; rest; rest &= rest - 1) {
+    int v = __builtin_ctzll(rest);
+    label[v] = count[__builtin_popcountll(g->adj[v])]++;
+  }
+  uint64_t adj[DELCON_MAX_VERTICES];
+  for (uint64_t rest = alive; rest; rest &= rest - 1) {
+    int v = __builtin_ctzll(rest);
+    uint64_t mapped = 0;
+    for (uint64_t nb = g->adj[v]; nb; nb &= nb - 1)
+      mapped |= 1ULL << label[__builtin_ctzll(nb)];
+    adj[label[v]] = mapped;
+  }
+  g->n = n;
+  memcpy(g->adj, adj, n * sizeof(uint64_t));
+}
+
+/* Remove the simplicial vertices of g until none is left, and relabel the
+rest. Returns how many were removed, after storing into k the number of
+neighbours each had when it was removed. */
+int _delcon_reduce(DelconGraph *g, int *k) {
+  uint64_t alive = g->n == 64 ? ~0ULL : (1ULL << g->n) - 1;
+  int removed = 0;
+  for (bool again = true; again;) {
+    again = false;
+    for (uint64_t rest = alive; rest; rest &= rest - 1) {
+      int v = __builtin_ctzll(rest);
+      uint64_t nb = g->adj[v] & alive;
+      bool clique = true;
+      for (uint64_t w = nb; w && clique; w &= w - 1) {
+        int u = __builtin_ctzll(w);
+        clique = (nb & ~(g->adj[u] | 1ULL << u)) == 0;
+      }
+      if (clique) {
+        k[removed++] = __builtin_popcountll(nb);
+        alive &= ~(1ULL << v);
+        again = true;
+      }
+    }
+  }
+  _delcon_relabel(g, alive);
+  return removed;
+}
+
+int _delcon_edges(DelconGraph *g) {
+  int twice = 0;
+  for (int v = 0; v < g->n; v++)
+    twice += __builtin_popcountll(g->adj[v]);
+  return twice / 2;
+}
+
+/* Split the reduced graph g along an edge into deletion, with as many
+vertices, and contraction, with one fewer. The edge is one of a vertex of
+least degree, to its neighbour of largest degree. */
+void _delcon_split(DelconGraph *g, DelconGraph *deletion,
+                   DelconGraph *contraction) {
+  int v = 0, u = 63 - __builtin_clzll(g->adj[0]);
+  *deletion = *g;
+  deletion->adj[v] &= ~(1ULL << u);
+  deletion->adj[u] &= ~(1ULL << v);
+  // Merge v into u, then remove v by shifting the labels above it down
+  *contraction = *g;
+  uint64_t merged = (g->adj[u] | g->adj[v]) & ~(1ULL << u | 1ULL << v);
+  for (uint64_t w = g->adj[v]; w; w &= w - 1)
+    contraction->adj[__builtin_ctzll(w)] |= 1ULL << u;
+  contraction->adj[u] = merged;
+  uint64_t alive = (g->n == 64 ? ~0ULL : (1ULL << g->n) - 1) & ~(1ULL << v);
+  _delcon_relabel(contraction, alive);
+}
+
+
+/* Vertices of g reachable from the vertices in from without going through
+the vertices in avoid */
+uint64_t _delcon_reach(DelconGraph *g, uint64_t from, uint64_t avoid) {
+  uint64_t seen = from, frontier = from;
+  while (frontier) {
+    uint64_t next = 0;
+    for (; frontier; frontier &= frontier - 1)
+      next |= g->adj[__builtin_ctzll(frontier)];
+    frontier = next & ~seen & ~avoid;
+    seen |= frontier;
+  }
+  return seen;
+}
+
+/* If g, which must be reduced, is disconnected or has a cut vertex, return a
+part that meets the rest in at most that vertex, stored in cut, or -1.
+Returns 0 if g is 2-connected. */
+uint64_t _delcon_piece(DelconGraph *g, int *cut) {
+  uint64_t all = g->n == 64 ? ~0ULL : (1ULL << g->n) - 1;
+  *cut = -1;
+  uint64_t part = _delcon_reach(g, 1, 0);
+  if (part != all)
+    return part;
+  for (int c = 0; c < g->n; c++) {
+    uint64_t rest = all & ~(1ULL << c);
+    part = _delcon_reach(g, rest & -rest, 1ULL << c);
+    if (part != rest) {
+      *cut = c;
+      return part | 1ULL << c;
+    }
+  }
+  return 0;
+}
+
+/* The subgraph of g induced by the vertices in keep, relabeled */
+DelconGraph _delcon_induced(DelconGraph *g, uint64_t keep) {
+  DelconGraph h = *g;
+  _delcon_relabel(&h, keep);
+  return h;
+}
+
+unsigned _delcon_solve(DelconGraph *g, uint64_t *P);
+
+/* The polynomial of g, which need not be reduced, into its g->n + 1
+coefficients P. Returns the number of graphs that computing it took. */
+unsigned _delcon_solve_any(DelconGraph g, uint64_t *P) {
+  int k[DELCON_MAX_VERTICES];
+  int removed = _delcon_reduce(&g, k);
+  unsigned cost = _delcon_solve(&g, P);
+  for (int i = 0; i < removed; i++)
+    poly_mul_linear(P, g.n++, k[i]);
+  return cost;
+}
+
+/* The polynomial of g, which must be reduced, into its g->n + 1 coefficients
+P. Returns the number of graphs that computing it took. */
+unsigned _delcon_solve(DelconGraph *g, uint64_t *P) {
+  int n = g->n;
+  if (n == 0) {
+    P[0] = 1;
+    return 1;
+  }
+  uint64_t key[2];
+  _delcon_key(g, key);
+  if (_delcon_memo_get(key, n, P))
+    return 1;
+  // A failed lookup may leave anything in P
+  memset(P, 0, (n + 1) * sizeof(uint64_t));
+  unsigned cost = 1;
+  int cut;
+  uint64_t part = _delcon_piece(g, &cut);
+  if (part != 0) {
+    // P(G) = P(A) P(B), divided by x if A and B share a vertex
+    uint64_t all = g->n == 64 ? ~0ULL : (1ULL << g->n) - 1;
+    DelconGraph a = _delcon_induced(g, part);
+    DelconGraph b =
+        _delcon_induced(g, (all & ~part) | (cut >= 0 ? 1ULL << cut : 0));
+    uint64_t A[DELCON_MAX_VERTICES + 1], B[DELCON_MAX_VERTICES + 1];
+    cost += _delcon_solve_any(a, A) + _delcon_solve_any(b, B);
+    int shift = cut >= 0;
+    poly_add_product(P, A + shift, a.n - shift, B, b.n);
+  } else {
+    DelconGraph branch[2];
+    _delcon_split(g, &branch[0], &branch[1]);
+    for (int b = 0; b < 2; b++) {
+      uint64_t Q[DELCON_MAX_VERTICES + 1];
+      cost += _delcon_solve_any(branch[b], Q);
+      for (int i = 0; i <= branch[b].n; i++)
+        P[i] += b == 0 ? Q[i] : -Q[i];
+    }
+  }
+  _delcon_memo_put(key, n, P, cost);
+  return cost;
+}
+
+/* Push node onto the deque of its owner. Returns false if it is full. */
+bool _delcon_push(DelconWorker *w, DelconNode *node) {
+  long b = atomic_load_explicit(&w->bottom, memory_order_relaxed);
+  long t = atomic_load_explicit(&w->top, memory_order_acquire);
+  if (b - t >= DELCON_DEQUE_SIZE)
+    return false;
+  atomic_store_explicit(&w->nodes[b % DELCON_DEQUE_SIZE], node,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+  return true;
+}
+
+/* Pop the newest node of the deque of its owner, or NULL */
+DelconNode *_delcon_pop(DelconWorker *w) {
+  long b = atomic_load_explicit(&w->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&w->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  long t = atomic_load_explicit(&w->top, memory_order_relaxed);
+  if (t > b) {
+    atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+    return NULL;
+  }
+  DelconNode *node = atomic_load_explicit(&w->nodes[b % DELCON_DEQUE_SIZE],
+                                          memory_order_relaxed);
+  if (t == b) {
+    // The last node: race the thieves for it
+    if (!atomic_compare_exchange_strong_explicit(
+            &w->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+      node = NULL;
+    atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+  }
+  return node;
+}
+
+/* Steal the oldest node of the deque of w, or NULL */
+DelconNode *_delcon_steal(DelconWorker *w) {
+  long t = atomic_load_explicit(&w->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  long b = atomic_load_explicit(&w->bottom, memory_order_acquire);
+  if (t >= b)
+    return NULL;
+  DelconNode *node = atomic_load_explicit(&w->nodes[t % DELCON_DEQUE_SIZE],
+                                          memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(
+          &w->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+    return NULL;
+  return node;
+}
+
+/* Hand the polynomial P of the reduced graph of node, which took cost graphs,
+to its parent, and free node. The last branch of a parent to be computed
+computes the parent, and so on up. */
+void _delcon_complete(DelconTask *task, DelconNode *node, uint64_t *P,
+                      unsigned cost) {
+  uint64_t Q[DELCON_MAX_VERTICES + 1];
+  memcpy(Q, P, (node->graph.n + 1) * sizeof(uint64_t));
+  for (;;) {
+    int degree = node->graph.n;
+    for (int i = 0; i < node->removed; i++)
+      poly_mul_linear(Q, degree++, node->k[i]);
+    DelconNode *parent = node->parent;
+    int branch = node->branch;
+    free(node);
+    if (parent == NULL) {
+      memcpy(task->result, Q, (degree + 1) * sizeof(uint64_t));
+      atomic_store(&task->done, true);
+      return;
+    }
+    memcpy(parent->branch_P[branch], Q, (degree + 1) * sizeof(uint64_t));
+    parent->cost[branch] = cost;
+    if (atomic_fetch_sub_explicit(&parent->waiting, 1,
+                                  memory_order_acq_rel) != 1)
+      return;
+    node = parent;
+    int n = node->graph.n;
+    for (int i = 0; i < n; i++)
+      Q[i] = node->branch_P[0][i] - node->branch_P[1][i];
+    Q[n] = node->branch_P[0][n];
+    cost = 1 + node->cost[0] + node->cost[1];
+    // Polynomials handed up by a cancelled task are wrong
+    if (!atomic_load(&task->stop))
+      _delcon_memo_put(node->key, n, Q, cost);
+  }
+}
+
+DelconNode *_delcon_node(DelconNode *parent, int branch) {
+  DelconNode *node = malloc(sizeof(DelconNode));
+  node->parent = parent;
+  node->branch = branch;
+  node->removed = 0;
+  return node;
+}
+
+/* Expand node on the thread of worker w: compute it if it is below the grain
+size or in the memo table, else push its two branches */
+void _delcon_expand(DelconTask *task, DelconWorker *w, DelconNode *node) {
+  DelconGraph *g = &node->graph;
+  node->removed = _delcon_reduce(g, node->k);
+  uint64_t Q[DELCON_MAX_VERTICES + 1];
+  if (g->n == 0 || _delcon_edges(g) - g->n <= DELCON_GRAIN) {
+    unsigned cost = _delcon_solve(g, Q);
+    _delcon_complete(task, node, Q, cost);
+    return;
+  }
+  _delcon_key(g, node->key);
+  if (_delcon_memo_get(node->key, g->n, Q)) {
+    _delcon_complete(task, node, Q, 1);
+    return;
+  }
+  DelconNode *branch[2] = {_delcon_node(node, 0), _delcon_node(node, 1)};
+  _delcon_split(g, &branch[0]->graph, &branch[1]->graph);
+  atomic_init(&node->waiting, 2);
+  for (int b = 1; b >= 0; b--) {
+    // Only a deque deeper than any branch can be full, but then expanding
+    // the node in place is still correct
+    if (!_delcon_push(w, branch[b]))
+      _delcon_expand(task, w, branch[b]);
+  }
+}
+
+/* Expand nodes until the whole graph is computed or the task is cancelled,
+stealing them once the deque of w is empty */
+void _delcon_work(DelconTask *task, int index) {
+  DelconWorker *w = &task->workers[index];
+  while (!atomic_load(&task->done) && !atomic_load(&task->stop)) {
+    if (task->run->cancel) {
+      atomic_store(&task->stop, true);
+      break;
+    }
+    DelconNode *node = _delcon_pop(w);
+    if (node == NULL && task->thread_count > 1) {
+      w->seed = _mix64(w->seed);
+      int victim = w->seed % (task->thread_count - 1);
+      node = _delcon_steal(&task->workers[victim + (victim >= index)]);
+    }
+    if (node == NULL)
+      thrd_yield();
+    else
+      _delcon_expand(task, w, node);
+  }
+}
+
+/* The task the team may take a helper for, the one with the fewest helpers,
+or NULL. Must hold delcon_team.mutex. */
+DelconTask *_delcon_pick_task() {
+  DelconTask *best = NULL;
+  if (delcon_team.busy >= delcon_team.size)
+    return NULL;
+  array_foreach(&delcon_team.tasks, DelconTask * task) {
+    if (task->joined + 1 < task->thread_count && !atomic_load(&task->done) &&
+        !atomic_load(&task->stop) &&
+        (best == NULL || task->helping < best->helping))
+      best = task;
+  }
+  return best;
+}
+
+int _delcon_helper(void *arg) {
+  (void)arg;
+  if (delcon_team.thread_start != NULL)
+    delcon_team.thread_start("delcon");
+  mtx_lock(&delcon_team.mutex);
+  while (!delcon_team.shutdown) {
+    DelconTask *task = _delcon_pick_task();
+    if (task == NULL) {
+      cnd_wait(&delcon_team.changed, &delcon_team.mutex);
+      continue;
+    }
+    int index = ++task->joined;
+    task->helping++;
+    delcon_team.busy++;
+    mtx_unlock(&delcon_team.mutex);
+
+    PerfPhase perf = {0};
+    perf_phase_begin(&perf);
+    _delcon_work(task, index);
+    perf_phase_end(&perf);
+
+    mtx_lock(&delcon_team.mutex);
+    perf_phase_add(&task->helper_perf, &perf);
+    task->helping--;
+    delcon_team.busy--;
+    cnd_broadcast(&delcon_team.changed);
+  }
+  mtx_unlock(&delcon_team.mutex);
+  return 0;
+}
+
+/* Start thread_count - 1 helper threads, each of which first calls
+thread_start unless it is NULL, so that tasks use up to thread_count threads
+in all */
+void delcon_init(int thread_count, void (*thread_start)(const char *role)) {
+  memset(&delcon_team, 0, sizeof(delcon_team));
+  mtx_init(&delcon_team.mutex, mtx_plain);
+  cnd_init(&delcon_team.changed);
+  array_init(&delcon_team.tasks);
+  delcon_team.size = thread_count > 1 ? thread_count : 1;
+  delcon_team.thread_start = thread_start;
+  int count = delcon_team.size - 1;
+  delcon_team.threads = malloc((count > 0 ? count : 1) * sizeof(thrd_t));
+  for (int i = 0; i < count; i++) {
+    if (thrd_create(&delcon_team.threads[i], _delcon_helper, NULL) !=
+        thrd_success) {
+      printf("Failed to create delcon thread\n");
+      break;
+    }
+    delcon_team.thread_count++;
+  }
+}
+
+/* Join the helper threads, once no task is stepping */
+void delcon_term() {
+  mtx_lock(&delcon_team.mutex);
+  delcon_team.shutdown = true;
+  cnd_broadcast(&delcon_team.changed);
+  mtx_unlock(&delcon_team.mutex);
+  for (int i = 0; i < delcon_team.thread_count; i++) {
+    if (thrd_join(delcon_team.threads[i], NULL) != thrd_success)
+      printf("Error joining thread\n");
+  }
+  free(delcon_team.threads);
+  array_term(&delcon_team.tasks);
+  cnd_destroy(&delcon_team.changed);
+  mtx_destroy(&delcon_team.mutex);
+}
+
+/* Start computing the chromatic polynomial of the graph with n vertices into
+P, which must have n entries. Returns false if the graph has too many
+vertices. */
+bool delcon_task_start(DelconTask *task, int n, array_edge *edges,
+                       array_ll *P) {
+  if (n > DELCON_MAX_VERTICES)
+    return false;
+  call_once(&delcon_memo_once, _delcon_memo_init);
+  task->n = n;
+  task->P = P;
+  task->thread_count = delcon_team.thread_count + 1;
+  task->joined = task->helping = 0;
+  memset(&task->helper_perf, 0, sizeof(task->helper_perf));
+  task->workers = calloc(task->thread_count, sizeof(DelconWorker));
+  for (int i = 0; i < task->thread_count; i++)
+    task->workers[i].seed = i + 1;
+  atomic_init(&task->done, false);
+  atomic_init(&task->stop, false);
+  DelconNode *root = _delcon_node(NULL, 0);
+  memset(&root->graph, 0, sizeof(root->graph));
+  root->graph.n = n;
+  array_foreach(edges, Edge edge) {
+    if (edge.start_idx == edge.end_idx)
+      continue;
+    root->graph.adj[edge.start_idx] |= 1ULL << edge.end_idx;
+    root->graph.adj[edge.end_idx] |= 1ULL << edge.start_idx;
+  }
+  _delcon_push(&task->workers[0], root);
+  return true;
+}
+
+/*
+ * Run the task until it finishes or budget is used up. Returns whether it has
+ * finished, which includes being aborted through run. A step that may run to
+ * the end is shared with the helpers of the team that are free; other steps
+ * run on the calling thread only. The counters of the helpers are summed in
+ * task->helper_perf.
+ */
+bool delcon_task_step(DelconTask *task, EngineRun *run, EngineBudget *budget) {
+  task->run = run;
+  if (budget->deadline == INFINITY && task->thread_count > 1) {
+    mtx_lock(&delcon_team.mutex);
+    array_add(&delcon_team.tasks, task);
+    delcon_team.busy++;
+    cnd_broadcast(&delcon_team.changed);
+    mtx_unlock(&delcon_team.mutex);
+
+    _delcon_work(task, 0);
+
+    // No helper may join once the task is off the list, and the deques must
+    // outlive those that did
+    mtx_lock(&delcon_team.mutex);
+    array_enumerate(&delcon_team.tasks, i, DelconTask * t) {
+      if (t == task) {
+        array_del(&delcon_team.tasks, i);
+        break;
+      }
+    }
+    delcon_team.busy--;
+    cnd_broadcast(&delcon_team.changed);
+    while (task->helping > 0)
+      cnd_wait(&delcon_team.changed, &delcon_team.mutex);
+    mtx_unlock(&delcon_team.mutex);
+    return true;
+  }
+  // Without helpers every node is in the deque of the calling thread
+  while (!atomic_load(&task->done) && !run->cancel) {
+    if (engine_yield(budget))
+      return false;
+    _delcon_expand(task, &task->workers[0], _delcon_pop(&task->workers[0]));
+  }
+  return true;
+}
+
+/* Free the task, after writing the polynomial into P. Returns false if it was
+aborted, and P is then incomplete. */
+bool delcon_task_finish(DelconTask *task) {
+  bool completed = atomic_load(&task->done);
+  if (completed) {
+    // Residues modulo 2^64, for poly_is_exact() to check
+    for (int i = 1; i <= task->n; i++)
+      array_at(task->P, i - 1) = (long long)task->result[i];
+  } else {
+    // Hand zeros up from the nodes left, which frees every node
+    atomic_store(&task->stop, true);
+    uint64_t zero[DELCON_MAX_VERTICES + 1] = {0};
+    for (int t = 0; t < task->thread_count; t++) {
+      for (DelconNode *node; (node = _delcon_pop(&task->workers[t]));)
+        _delcon_complete(task, node, zero, 0);
+    }
+  }
+  free(task->workers);
+  return completed;
+}
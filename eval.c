@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Evaluation and real root isolation of chromatic polynomials.
+ * Polynomials are given in the same form the engines produce them: an
+ * array_ll P where P[i] is the coefficient of x^(i+1). There is no constant
+ * term, since P(0) = 0 for every graph with at least one vertex.
+ */
+#include "array.h"
+#include "bigint.c"
+#include <math.h>
+
+/* Exact value of P(k) for an integer k, using Horner's rule */
+BigInt poly_eval_exact(array_ll *P, long long k) {
+  BigInt result;
+  bigint_init(&result);
+  for (int i = array_size(P) - 1; i >= 0; i--) {
+    bigint_add_ll(&result, array_at(P, i));
+    bigint_mul_ll(&result, k);
+  }
+  return result;
+}
+
+typedef double v4d __attribute__((vector_size(4 * sizeof(double))));
+
+/* Evaluate P at count points xs[i], storing the results in ys[i].
+Horner's rule is run on four points at a time using GCC vector extensions,
+which compile down to whatever SIMD width the target supports. */
+void poly_eval_many(array_ll *P, const double *xs, double *ys, int count) {
+  int n = array_size(P);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    v4d x, acc = {0, 0, 0, 0};
+    memcpy(&x, xs + i, sizeof(x));
+    for (int j = n - 1; j >= 0; j--)
+      acc = (acc + (double)array_at(P, j)) * x;
+    memcpy(ys + i, &acc, sizeof(acc));
+  }
+  // Leftover points that do not fill a whole vector
+  for (; i < count; i++) {
+    double acc = 0;
+    for (int j = n - 1; j >= 0; j--)
+      acc = (acc + array_at(P, j)) * xs[i];
+    ys[i] = acc;
+  }
+}
+
+/* A Sturm sequence, each polynomial stored as long double coefficients of
+increasing degree, at most STURM_MAX_DEGREE. */
+#define STURM_MAX_DEGREE 128
+typedef struct {
+  int len;
+  int degrees[STURM_MAX_DEGREE + 2];
+  long double coeffs[STURM_MAX_DEGREE + 2][STURM_MAX_DEGREE + 1];
+} SturmSequence;
+
+long double _horner_ld(long double *c, int degree, long double x) {
+  long double acc = 0;
+  for (int i = degree; i >= 0; i--)
+    acc = acc * x + c[i];
+  return acc;
+}
+
+/* Scale c so that its largest coefficient has absolute value 1, and drop
+coefficients that are negligible relative to it. Returns the new degree, or -1
+if c is (numerically) zero relative to ref. */
+int _normalize_ld(long double *c, int degree, long double ref) {
+  long double max = 0;
+  for (int i = 0; i <= degree; i++)
+    if (fabsl(c[i]) > max)
+      max = fabsl(c[i]);
+  if (max <= ref * 1e-12L)
+    return -1;
+  for (int i = 0; i <= degree; i++)
+    c[i] /= max;
+  while (degree >= 0 && fabsl(c[degree]) < 1e-15L)
+    degree--;
+  return degree;
+}
+
+void _build_sturm_sequence(SturmSequence *S, long double *q, int degree) {
+  memcpy(S->coeffs[0], q, (degree + 1) * sizeof(long double));
+  S->degrees[0] = _normalize_ld(S->coeffs[0], degree, 0);
+  for (int i = 1; i <= degree; i++)
+    S->coeffs[1][i - 1] = i * q[i];
+  S->degrees[1] = _normalize_ld(S->coeffs[1], degree - 1, 0);
+  S->len = 2;
+
+  // s_{i+1} = -rem(s_{i-1}, s_i), until the remainder vanishes
+  while (S->degrees[S->len - 1] > 0) {
+    int a = S->len - 2, b = S->len - 1;
+    long double r[STURM_MAX_DEGREE + 1];
+    int dr = S->degrees[a], db = S->degrees[b];
+    memcpy(r, S->coeffs[a], (dr + 1) * sizeof(long double));
+    for (int shift = dr - db; shift >= 0; shift--) {
+      long double f = r[shift + db] / S->coeffs[b][db];
+      for (int k = 0; k <= db; k++)
+        r[shift + k] -= f * S->coeffs[b][k];
+    }
+    int deg = _normalize_ld(r, db - 1, 1);
+    if (deg < 0)
+      break;
+    for (int k = 0; k <= deg; k++)
+      S->coeffs[S->len][k] = -r[k];
+    S->degrees[S->len++] = deg;
+  }
+}
+
+/* Number of sign changes in the Sturm sequence at x */
+int _sturm_variations(SturmSequence *S, long double x) {
+  int variations = 0;
+  int last_sign = 0;
+  for (int i = 0; i < S->len; i++) {
+    long double y = _horner_ld(S->coeffs[i], S->degrees[i], x);
+    int sign = (y > 0) - (y < 0);
+    if (sign == 0)
+      continue;
+    if (last_sign != 0 && sign != last_sign)
+      variations++;
+    last_sign = sign;
+  }
+  return variations;
+}
+
+/* Collect the distinct roots in (a, b], given the variations at a and b */
+void _isolate_roots(SturmSequence *S, long double a, long double b, int va,
+                    int vb, array_double *roots) {
+  int count = va - vb;
+  if (count <= 0)
+    return;
+  if (count == 1 || b - a < 1e-12L) {
+    // Bisect until the interval is tight, keeping the root inside (a, b]
+    for (int iter = 0; iter < 80 && b - a > 1e-12L; iter++) {
+      long double m = (a + b) / 2;
+      int vm = _sturm_variations(S, m);
+      if (va - vm >= 1) {
+        b = m;
+        vb = vm;
+      } else {
+        a = m;
+        va = vm;
+      }
+    }
+    array_add(roots, (double)((a + b) / 2));
+    return;
+  }
+  long double m = (a + b) / 2;
+  int vm = _sturm_variations(S, m);
+  _isolate_roots(S, a, m, va, vm, roots);
+  _isolate_roots(S, m, b, vm, vb, roots);
+}
+
+int cmp_double(const void *a, const void *b) {
+  double x = *((double *)a);
+  double y = *((double *)b);
+  return (x > y) - (x < y);
+}
+
+/*
+ * Returns the distinct real roots of P in increasing order.
+ * Integer roots (a chromatic polynomial can only have 0, 1, ..., chi-1) are
+ * divided out exactly first, so they are reported exactly and do not disturb
+ * the floating point Sturm sequence with their multiplicities. The remaining
+ * roots are isolated with a Sturm sequence and refined by bisection.
+ */
+array_double poly_real_roots(array_ll *P) {
+  array_double roots;
+  array_init(&roots);
+
+  // c[i] is the coefficient of x^i
+  int degree = array_size(P);
+  while (degree > 0 && array_at(P, degree - 1) == 0)
+    degree--;
+  if (degree == 0 || degree > STURM_MAX_DEGREE)
+    return roots;
+  long long c[STURM_MAX_DEGREE + 1];
+  c[0] = 0;
+  for (int i = 1; i <= degree; i++)
+    c[i] = array_at(P, i - 1);
+
+  // Deflate integer roots r = 0, 1, 2, ... by synthetic division
+  int n = degree;
+  for (long long r = 0; r < n && degree > 0;) {
+    long long b[STURM_MAX_DEGREE + 1];
+    long long rem = c[degree];
+    bool overflow = false;
+    for (int i = degree - 1; i >= 0; i--) {
+      b[i] = rem;
+      overflow |= __builtin_mul_overflow(rem, r, &rem);
+      overflow |= __builtin_add_overflow(rem, c[i], &rem);
+    }
+    if (overflow)
+      break;
+    if (rem != 0) {
+      r++;
+      continue;
+    }
+    if (array_size(&roots) == 0 || array_last(&roots) != r)
+      array_add(&roots, r);
+    memcpy(c, b, degree * sizeof(long long));
+    degree--;
+  }
+
+  if (degree >= 1) {
+    long double q[STURM_MAX_DEGREE + 1];
+    long double bound = 0;
+    for (int i = 0; i <= degree; i++) {
+      q[i] = c[i];
+      if (fabsl(q[i] / c[degree]) > bound)
+        bound = fabsl(q[i] / c[degree]);
+    }
+    // Cauchy's bound, widened so the endpoints are never roots themselves
+    bound += 1.5L;
+
+    SturmSequence *S = malloc(sizeof(SturmSequence));
+    _build_sturm_sequence(S, q, degree);
+    _isolate_roots(S, -bound, bound, _sturm_variations(S, -bound),
+                   _sturm_variations(S, bound), &roots);
+    free(S);
+  }
+
+  array_sort(&roots, cmp_double);
+  return roots;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Reading graphs from files.
+ * The format is a plain edge list: one edge "u v" per line, where u and v are
+ * non-negative integer labels. Blank lines and lines starting with '#' or '%'
+ * (comments in SNAP and Matrix Market files) are skipped, as is anything after
+ * the two labels. Labels need not be contiguous: they are renumbered 0..n-1 in
+ * increasing order. Self-loops and repeated edges are dropped.
+ *
+ * Included from chrompoly.c after scheduler.c, for Edge and cmp_edge.
+ */
+#include "array.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int cmp_ll(const void *a, const void *b) {
+  long long x = *((long long *)a), y = *((long long *)b);
+  return (x > y) - (x < y);
+}
+
+int _label_index(array_ll *labels, long long label) {
+  long long *found = bsearch(&label, labels->elems, array_size(labels),
+                             sizeof(long long), cmp_ll);
+  return found - labels->elems;
+}
+
+/* Read the edge list at path into n and edges (which must be empty). Returns
+false, after printing why, if the file cannot be read or is malformed. */
+bool import_edge_list(const char *path, int *n, array_edge *edges) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    printf("Failed to open %s\n", path);
+    return false;
+  }
+  array_ll ends; // u0, v0, u1, v1, ...
+  array_init(&ends);
+  char line[256];
+  int line_number = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file) != NULL) {
+    line_number++;
+    char *p = line;
+    while (*p == ' ' || *p == '\t')
+      p++;
+    if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#' || *p == '%')
+      continue;
+    long long u, v;
+    if (sscanf(p, "%lld %lld", &u, &v) != 2 || u < 0 || v < 0) {
+      printf("%s:%d: expected two non-negative labels\n", path, line_number);
+      ok = false;
+    } else if (u != v) {
+      array_add(&ends, u);
+      array_add(&ends, v);
+    }
+  }
+  fclose(file);
+  if (!ok) {
+    array_term(&ends);
+    return false;
+  }
+
+  // Sorted distinct labels; a label's index in this list is its node number
+  array_ll labels;
+  array_init(&labels);
+  array_foreach(&ends, long long label) { array_add(&labels, label); }
+  array_sort(&labels, cmp_ll);
+  int distinct = 0;
+  array_enumerate(&labels, i, long long label) {
+    if (distinct == 0 || label != array_at(&labels, distinct - 1))
+      array_at(&labels, distinct++) = label;
+  }
+  labels.size = distinct;
+
+  for (int i = 0; i < array_size(&ends); i += 2) {
+    int a = _label_index(&labels, array_at(&ends, i));
+    int b = _label_index(&labels, array_at(&ends, i + 1));
+    array_add(edges, ((Edge){a < b ? a : b, a < b ? b : a}));
+  }
+  array_sort(edges, cmp_edge);
+  int kept = 0;
+  array_enumerate(edges, i, Edge edge) {
+    if (kept == 0 || !edge_eq(edge, array_at(edges, kept - 1)))
+      array_at(edges, kept++) = edge;
+  }
+  edges->size = kept;
+  *n = distinct;
+
+  array_term(&labels);
+  array_term(&ends);
+  return true;
+}
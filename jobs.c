@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * A pool of worker threads running jobs in three priority classes:
+ * - foreground: the polynomial of the graph on the canvas. Only the latest
+ *   one matters, so submitting a new one supersedes the previous one.
+ * - on demand: requested explicitly by the user, e.g. chi(G).
+ * - background: speculative work, e.g. the graph minus the selected node,
+ *   whose results only fill the result cache.
+ * Idle threads always pick the most urgent queued job. Each class may only
+ * occupy up to its quota of threads, and when a job is submitted while every
+ * thread is busy, a job of a less urgent class is preempted (cancelled and
+ * requeued) to make room. So background work never delays the foreground.
+ * A pool may also have no threads at all, in which case its owner runs the
+ * jobs itself, one at a time, taking them with jobs_take().
+ *
+ * Included from chrompoly.c after scheduler.c, for GraphSnapshot and
+ * EngineRun.
+ */
+#include "array.h"
+#include "trace.h"
+#include <threads.h>
+
+typedef enum {
+  JOB_FOREGROUND,
+  JOB_ON_DEMAND,
+  JOB_BACKGROUND,
+  JOB_CLASS_COUNT
+} JobClass;
+
+const char *job_class_names[] = {"foreground", "on-demand", "background"};
+
+typedef enum {
+  JOB_POLYNOMIAL,       // Chromatic polynomial of the graph
+  JOB_CHROMATIC_NUMBER, // Smallest k with P(k) > 0
+  JOB_SELECTION,        // Chromatic polynomial of the selected nodes
+  JOB_SENSITIVITY,      // Effect of adding or removing each single edge
+} JobKind;
+
+typedef struct {
+  int id;
+  JobClass cls;
+  JobKind kind;
+  GraphSnapshot graph;
+  EngineRun run;
+  bool preempted; // Cancelled to make room for a more urgent job: requeue it
+  bool settled;   // Its result was claimed by jobs_is_current(): too late to
+                  // promote it
+} Job;
+
+typedef void (*JobFunction)(Job *job);
+// Called by each worker thread when it starts, e.g. to set its priority
+typedef void (*ThreadStart)(const char *role);
+
+typedef struct {
+  mtx_t mutex;
+  cnd_t work_available;
+  bool shutdown;
+  JobFunction execute;
+  ThreadStart thread_start; // May be NULL
+  array_ptr queues[JOB_CLASS_COUNT]; // Queued jobs of each class, oldest first
+  array_ptr running;
+  int running_count[JOB_CLASS_COUNT];
+  int quota[JOB_CLASS_COUNT]; // Most threads that may run a class at once
+  int thread_count;
+  int slots; // Jobs that may run at once: thread_count, or 1 without threads
+  thrd_t *threads;
+  int next_id;
+  int foreground_id; // The latest foreground job, the only one that counts
+} JobPool;
+
+void _job_free(Job *job) {
+  array_term(&job->graph.edges);
+  free(job);
+}
+
+/* Most urgent queued job whose class is within its quota, or NULL */
+Job *_pick_job(JobPool *pool) {
+  for (int cls = 0; cls < JOB_CLASS_COUNT; cls++) {
+    if (array_size(&pool->queues[cls]) > 0 &&
+        pool->running_count[cls] < pool->quota[cls])
+      return array_at(&pool->queues[cls], 0);
+  }
+  return NULL;
+}
+
+void _remove_ptr(array_ptr *a, void *p) {
+  array_enumerate(a, i, void *q) {
+    if (q == p) {
+      array_del(a, i);
+      break;
+    }
+  }
+}
+
+/* Move job, picked by _pick_job(), from its queue to the running jobs. Must
+hold pool->mutex. */
+void _start_job(JobPool *pool, Job *job) {
+  array_del(&pool->queues[job->cls], 0);
+  array_add(&pool->running, job);
+  pool->running_count[job->cls]++;
+}
+
+/* Requeue job if it was preempted, and free it otherwise. Must hold
+pool->mutex. */
+void _finish_job(JobPool *pool, Job *job) {
+  _remove_ptr(&pool->running, job);
+  pool->running_count[job->cls]--;
+  if (job->preempted && !pool->shutdown) {
+    // Requeue at the front of its class, to resume as soon as possible
+    job->preempted = false;
+    job->run = (EngineRun){0};
+    array_add(&pool->queues[job->cls], NULL);
+    array_ptr *queue = &pool->queues[job->cls];
+    memmove(queue->elems + 1, queue->elems,
+            (array_size(queue) - 1) * sizeof(void *));
+    array_at(queue, 0) = job;
+  } else {
+    _job_free(job);
+  }
+  // Finishing may have put another class back under its quota
+  cnd_broadcast(&pool->work_available);
+}
+
+int _worker(void *arg) {
+  JobPool *pool = arg;
+  if (pool->thread_start != NULL)
+    pool->thread_start("worker");
+  mtx_lock(&pool->mutex);
+  while (true) {
+    Job *job;
+    while (!pool->shutdown && (job = _pick_job(pool)) == NULL)
+      cnd_wait(&pool->work_available, &pool->mutex);
+    if (pool->shutdown)
+      break;
+    _start_job(pool, job);
+    // jobs_submit() may promote the job while it runs
+    const char *class_name = job_class_names[job->cls];
+    mtx_unlock(&pool->mutex);
+
+    TRACE_BEGIN(class_name);
+    pool->execute(job);
+    TRACE_END(class_name);
+
+    mtx_lock(&pool->mutex);
+    _finish_job(pool, job);
+  }
+  mtx_unlock(&pool->mutex);
+  return 0;
+}
+
+/*
+ * Starts thread_count workers, or none if thread_count is 0, each of which
+ * first calls thread_start unless it is NULL. By default foreground jobs may
+ * use every thread, on-demand jobs all but one, and background jobs a quarter
+ * of them (always at least one thread each).
+ */
+void jobs_init(JobPool *pool, int thread_count, JobFunction execute,
+               ThreadStart thread_start) {
+  memset(pool, 0, sizeof(*pool));
+  mtx_init(&pool->mutex, mtx_plain);
+  cnd_init(&pool->work_available);
+  pool->execute = execute;
+  pool->thread_start = thread_start;
+  pool->thread_count = thread_count;
+  pool->slots = thread_count > 0 ? thread_count : 1;
+  pool->quota[JOB_FOREGROUND] = pool->slots;
+  pool->quota[JOB_ON_DEMAND] = pool->slots > 1 ? pool->slots - 1 : 1;
+  pool->quota[JOB_BACKGROUND] = pool->slots >= 4 ? pool->slots / 4 : 1;
+  pool->foreground_id = -1;
+  pool->threads = malloc(thread_count * sizeof(thrd_t));
+  for (int i = 0; i < thread_count; i++) {
+    if (thrd_create(&pool->threads[i], _worker, pool) != thrd_success) {
+      printf("Failed to create worker thread\n");
+      pool->thread_count = pool->slots = i;
+      break;
+    }
+  }
+}
+
+/* Cancel queued and running jobs of class cls. Must hold pool->mutex. */
+void _cancel_class(JobPool *pool, JobClass cls) {
+  array_foreach(&pool->queues[cls], void *job) { _job_free(job); }
+  array_clear(&pool->queues[cls]);
+  array_foreach(&pool->running, Job * job) {
+    if (job->cls == cls) {
+      TRACE_INSTANT("cancel", job->id);
+      job->preempted = false;
+      job->run.cancel = true;
+    }
+  }
+}
+
+/* If no thread is free, preempt the least urgent running job that is less
+urgent than cls. Must hold pool->mutex. */
+void _preempt_for(JobPool *pool, JobClass cls) {
+  int busy = 0;
+  array_foreach(&pool->running, Job * job) { busy += !job->run.cancel; }
+  if (busy < pool->slots)
+    return;
+  Job *victim = NULL;
+  array_foreach(&pool->running, Job * job) {
+    if (job->cls > cls && !job->run.cancel &&
+        (victim == NULL || job->cls > victim->cls))
+      victim = job;
+  }
+  if (victim != NULL) {
+    TRACE_INSTANT("preempt", victim->id);
+    victim->preempted = true;
+    victim->run.cancel = true;
+  }
+}
+
+/*
+ * Queue a job computing kind for graph, which the pool takes ownership of.
+ * A new foreground job supersedes the previous one and all speculative work,
+ * except a background job for the very same graph, which is promoted to the
+ * foreground instead of being started over. A job whose result has already
+ * been settled is not promoted: a new job is queued, which the result cache
+ * answers at once. Returns the job id.
+ */
+int jobs_submit(JobPool *pool, JobClass cls, JobKind kind,
+                GraphSnapshot graph) {
+  mtx_lock(&pool->mutex);
+  int id = pool->next_id++;
+  TRACE_INSTANT("submit", id);
+
+  if (cls == JOB_FOREGROUND && kind == JOB_POLYNOMIAL) {
+    pool->foreground_id = id;
+    Job *promoted = NULL;
+    array_foreach(&pool->running, Job * job) {
+      if (job->cls == JOB_BACKGROUND && job->kind == JOB_POLYNOMIAL &&
+          !job->run.cancel && !job->settled && snapshot_eq(&job->graph, &graph))
+        promoted = job;
+    }
+    _cancel_class(pool, JOB_FOREGROUND);
+    if (promoted != NULL) {
+      pool->running_count[JOB_BACKGROUND]--;
+      pool->running_count[JOB_FOREGROUND]++;
+      promoted->cls = JOB_FOREGROUND;
+      promoted->id = id;
+      array_term(&graph.edges);
+    }
+    _cancel_class(pool, JOB_BACKGROUND);
+    if (promoted != NULL) {
+      mtx_unlock(&pool->mutex);
+      return id;
+    }
+  }
+
+  Job *job = calloc(1, sizeof(Job));
+  job->id = id;
+  job->cls = cls;
+  job->kind = kind;
+  job->graph = graph;
+  array_add(&pool->queues[cls], job);
+  _preempt_for(pool, cls);
+  cnd_broadcast(&pool->work_available);
+  mtx_unlock(&pool->mutex);
+  return id;
+}
+
+/* Cancel the job with the given id, queued or running, e.g. when the user
+asks again for what it computes. Does nothing if it has finished. */
+void jobs_cancel(JobPool *pool, int id) {
+  mtx_lock(&pool->mutex);
+  for (int cls = 0; cls < JOB_CLASS_COUNT; cls++) {
+    array_foreach(&pool->queues[cls], Job * job) {
+      if (job->id == id) {
+        _remove_ptr(&pool->queues[cls], job);
+        _job_free(job);
+        break;
+      }
+    }
+  }
+  array_foreach(&pool->running, Job * job) {
+    if (job->id == id) {
+      TRACE_INSTANT("cancel", job->id);
+      job->preempted = false;
+      job->run.cancel = true;
+    }
+  }
+  mtx_unlock(&pool->mutex);
+}
+
+/* In a pool without threads, take the most urgent queued job, or return NULL
+if there is none. The caller runs it, stopping once job->run.cancel is set,
+and then hands it back with jobs_finish(). */
+Job *jobs_take(JobPool *pool) {
+  mtx_lock(&pool->mutex);
+  Job *job = pool->shutdown ? NULL : _pick_job(pool);
+  if (job != NULL)
+    _start_job(pool, job);
+  mtx_unlock(&pool->mutex);
+  return job;
+}
+
+/* Hand back a job taken with jobs_take(), which requeues it if it was
+preempted and frees it otherwise */
+void jobs_finish(JobPool *pool, Job *job) {
+  mtx_lock(&pool->mutex);
+  _finish_job(pool, job);
+  mtx_unlock(&pool->mutex);
+}
+
+/* Is job the latest foreground job? Its results are stale otherwise. Once
+its engine has finished, this decides under the lock whether the job publishes
+as the foreground, and the job can no longer be promoted afterwards. */
+bool jobs_is_current(JobPool *pool, Job *job) {
+  mtx_lock(&pool->mutex);
+  job->settled = true;
+  bool current = job->cls == JOB_FOREGROUND && job->id == pool->foreground_id;
+  mtx_unlock(&pool->mutex);
+  return current;
+}
+
+/* Copy the progress of the latest foreground job into progress, if it is
+running. Returns whether it is. */
+bool jobs_foreground_progress(JobPool *pool, EngineRun *progress) {
+  bool running = false;
+  mtx_lock(&pool->mutex);
+  array_foreach(&pool->running, Job * job) {
+    if (job->cls == JOB_FOREGROUND && job->id == pool->foreground_id) {
+      *progress = job->run;
+      running = true;
+    }
+  }
+  mtx_unlock(&pool->mutex);
+  return running;
+}
+
+/* Cancel all jobs and join the worker threads */
+void jobs_shutdown(JobPool *pool) {
+  mtx_lock(&pool->mutex);
+  pool->shutdown = true;
+  for (int cls = 0; cls < JOB_CLASS_COUNT; cls++)
+    _cancel_class(pool, cls);
+  cnd_broadcast(&pool->work_available);
+  mtx_unlock(&pool->mutex);
+
+  for (int i = 0; i < pool->thread_count; i++) {
+    if (thrd_join(pool->threads[i], NULL) != thrd_success)
+      printf("Error joining thread\n");
+  }
+  for (int cls = 0; cls < JOB_CLASS_COUNT; cls++)
+    array_term(&pool->queues[cls]);
+  array_term(&pool->running);
+  free(pool->threads);
+  cnd_destroy(&pool->work_available);
+  mtx_destroy(&pool->mutex);
+}
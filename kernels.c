@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Specialised chromatic polynomial kernel for graphs with at most 8 vertices.
+ * Larger graphs are left to the deletion-contraction engine, which beats
+ * enumerating partitions from 9 vertices on.
+ *
+ * The submaps of a graph (the contractions enumerated by get_all_submaps())
+ * are exactly the partitions of its vertices into connected blocks. Here a
+ * partition is a 64-bit word holding a 4-bit block label per vertex. Labels
+ * are kept in first-occurrence order, so two partitions are equal iff their
+ * words are equal.
+ *
+ * The kernel runs as resumable steps, so that it can be spread over several
+ * frames of the render loop.
+ *
+ * Included from chrompoly.c after submap.c, for the Edge, EngineRun and
+ * EngineBudget types.
+ */
+#include "array.h"
+
+#define KERNEL_MAX_VERTICES 8
+#define _LABEL_BITS 4
+
+typedef uint64_t Partition;
+
+/* Block label of vertex v in p */
+static inline int _label_get(Partition p, int v) {
+  return p >> (v * _LABEL_BITS) & ((1 << _LABEL_BITS) - 1);
+}
+
+/* p with vertex v moved to block l */
+static inline Partition _label_set(Partition p, int v, int l) {
+  int shift = v * _LABEL_BITS;
+  return (p & ~((uint64_t)((1 << _LABEL_BITS) - 1) << shift)) |
+         (uint64_t)l << shift;
+}
+
+uint64_t _mix64(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+/* Is every block of fine, with n vertices, contained in a block of coarse? */
+static inline bool _partition_refines(Partition fine, Partition coarse, int n) {
+  int8_t map[KERNEL_MAX_VERTICES];
+  memset(map, -1, sizeof(map));
+  for (int v = 0; v < n; v++) {
+    int f = _label_get(fine, v);
+    int c = _label_get(coarse, v);
+    if (map[f] < 0)
+      map[f] = c;
+    else if (map[f] != c)
+      return false;
+  }
+  return true;
+}
+
+/* Merge block b of p, with n vertices, into block a < b, keeping labels in
+first-occurrence order */
+static inline Partition _partition_merge(Partition p, int a, int b, int n) {
+  Partition q = p;
+  for (int v = 0; v < n; v++) {
+    int l = _label_get(p, v);
+    if (l == b)
+      q = _label_set(q, v, a);
+    else if (l > b)
+      q = _label_set(q, v, l - 1);
+  }
+  return q;
+}
+
+/* Index of p in parts, or -1. slots is an open addressing table of indices
+into parts, with mask + 1 entries. */
+static int _partition_find(array_64 *parts, int *slots, uint64_t mask,
+                           Partition p, uint64_t *slot) {
+  for (*slot = _mix64(p) & mask; slots[*slot] >= 0;
+       *slot = (*slot + 1) & mask) {
+    if (array_at(parts, slots[*slot]) == p)
+      return slots[*slot];
+  }
+  return -1;
+}
+
+/* Resumable state of the kernel: the enumeration of the partitions layer by
+layer, then their Mobius values */
+typedef struct {
+  int n;
+  array_edge *edges;
+  array_ll *P;
+  bool aborted;
+  bool enumerated;
+  array_64 parts;
+  array_int layer_start; // Parts with n - i blocks start at index i
+  uint64_t mask;
+  int *slots;
+  long long *mobius;
+  int blocks;    // Blocks of the partitions being contracted
+  int layer;     // Layer whose Mobius values are being computed
+  int begin;     // Parts [begin, end) are the current layer
+  int end;
+  int i;         // Next part of the layer
+  int j;         // Next finer part compared with part i, -1 before the first
+  long long sum; // Mobius values of the finer parts so far
+} KernelTask;
+
+/*
+ * Start computing the chromatic polynomial of the graph with n vertices and
+ * the given edges into P (which must hold n zeroed coefficients, as in
+ * get_chromatic_polynomial()). edges and P must outlive the task.
+ */
+void kernel_task_start(KernelTask *t, int n, array_edge *edges, array_ll *P) {
+  assert(n <= KERNEL_MAX_VERTICES);
+  memset(t, 0, sizeof(*t));
+  t->n = n;
+  t->edges = edges;
+  t->P = P;
+  t->mask = 1023;
+  t->slots = malloc((t->mask + 1) * sizeof(int));
+  memset(t->slots, -1, (t->mask + 1) * sizeof(int));
+
+  // The discrete partition, i.e. the graph itself
+  Partition discrete = 0;
+  for (int v = 0; v < n; v++)
+    discrete = _label_set(discrete, v, v);
+  uint64_t slot;
+  _partition_find(&t->parts, t->slots, t->mask, discrete, &slot);
+  t->slots[slot] = 0;
+  array_add(&t->parts, discrete);
+  array_add(&t->layer_start, 0);
+  t->blocks = n;
+  t->begin = t->i = 0;
+  t->end = 1;
+  if (n > 1)
+    array_add(&t->layer_start, 1);
+}
+
+/* Add the partitions obtained by contracting one edge of part i */
+void _kernel_contract(KernelTask *t, int i, EngineRun *run) {
+  uint64_t slot;
+  uint8_t seen[KERNEL_MAX_VERTICES] = {0}; // seen[a] bit b: blocks a, b merged
+  Partition p = array_at(&t->parts, i);
+  array_foreach(t->edges, Edge edge) {
+    int a = _label_get(p, edge.start_idx);
+    int b = _label_get(p, edge.end_idx);
+    if (a == b)
+      continue;
+    if (a > b) {
+      int c = a;
+      a = b;
+      b = c;
+    }
+    if (seen[a] >> b & 1)
+      continue;
+    seen[a] |= 1 << b;
+    Partition q = _partition_merge(p, a, b, t->n);
+    if (_partition_find(&t->parts, t->slots, t->mask, q, &slot) >= 0)
+      continue;
+    t->slots[slot] = array_size(&t->parts);
+    array_add(&t->parts, q);
+    run->submap_count++;
+    // Keep the table at most half full
+    if (2 * array_size(&t->parts) > t->mask) {
+      t->mask = 2 * t->mask + 1;
+      t->slots = realloc(t->slots, (t->mask + 1) * sizeof(int));
+      memset(t->slots, -1, (t->mask + 1) * sizeof(int));
+      for (int j = 0; j < array_size(&t->parts); j++) {
+        _partition_find(&t->parts, t->slots, t->mask, array_at(&t->parts, j),
+                        &slot);
+        t->slots[slot] = j;
+      }
+    }
+  }
+}
+
+/* Make layer the current one of the Mobius pass */
+void _kernel_enter_layer(KernelTask *t, int layer) {
+  t->layer = layer;
+  t->begin = t->i = array_at(&t->layer_start, layer);
+  t->end = layer + 1 < array_size(&t->layer_start)
+               ? array_at(&t->layer_start, layer + 1)
+               : array_size(&t->parts);
+  t->j = -1;
+}
+
+/* Run the task until it is finished, budget is used up or it moves on to its
+next phase. Returns whether it is finished, which includes being aborted
+through run->cancel. */
+bool kernel_task_step(KernelTask *t, EngineRun *run, EngineBudget *budget) {
+  // Enumerate layer by layer: contracting an edge between two blocks of a
+  // partition with k blocks gives one with k - 1 blocks
+  while (!t->enumerated) {
+    if (t->i == t->end) {
+      if (--t->blocks <= 1) {
+        t->enumerated = true;
+        free(t->slots);
+        t->slots = NULL;
+        run->total_submap_count = array_size(&t->parts);
+        run->submap_count = 0;
+        t->mobius = malloc(array_size(&t->parts) * sizeof(long long));
+        _kernel_enter_layer(t, 0);
+        // Return between the phases, so they can be measured apart
+        return false;
+      }
+      t->begin = t->i = t->end;
+      t->end = array_size(&t->parts);
+      array_add(&t->layer_start, t->end);
+      continue;
+    }
+    if (run->cancel) {
+      t->aborted = true;
+      return true;
+    }
+    if (engine_yield(budget))
+      return false;
+    _kernel_contract(t, t->i++, run);
+  }
+
+  // mobius[i] = mu(discrete, parts[i]) = -sum of mu(discrete, s) over all s
+  // strictly finer than parts[i], which all lie in earlier layers
+  while (t->layer < array_size(&t->layer_start)) {
+    if (t->i == t->end) {
+      if (t->layer + 1 < array_size(&t->layer_start))
+        _kernel_enter_layer(t, t->layer + 1);
+      else
+        t->layer++;
+      continue;
+    }
+    if (t->j < 0) {
+      if (run->cancel) {
+        t->aborted = true;
+        return true;
+      }
+      run->matrix_rows_count++;
+      t->j = 0;
+      t->sum = 0;
+    }
+    for (; t->j < t->begin; t->j++) {
+      if (engine_yield(budget))
+        return false;
+      if (_partition_refines(array_at(&t->parts, t->j),
+                             array_at(&t->parts, t->i), t->n))
+        t->sum += t->mobius[t->j];
+    }
+    t->mobius[t->i] = t->i == 0 ? 1 : -t->sum;
+    array_at(t->P, t->n - t->layer - 1) += t->mobius[t->i];
+    t->i++;
+    t->j = -1;
+  }
+  return true;
+}
+
+/* 0 while the task enumerates the partitions, 1 while it computes their
+Mobius values */
+int kernel_task_phase(KernelTask *t) { return t->enumerated; }
+
+/* Free the task. Returns false if it was aborted, and P is then incomplete. */
+bool kernel_task_finish(KernelTask *t, EngineRun *run) {
+  run->matrix_rows_count = 0;
+  free(t->slots);
+  free(t->mobius);
+  array_term(&t->parts);
+  array_term(&t->layer_start);
+  if (t->aborted)
+    printf("aborted early\n");
+  return !t->aborted;
+}
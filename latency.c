@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * How long the user waits for the polynomial after editing the graph.
+ * Each burst of edits is timed from its first edit, the click the user
+ * remembers, to three milestones:
+ * - progress: the first progress update shown for it,
+ * - result: the polynomial published by an engine or the result cache,
+ * - shown: the end of the first frame that draws it.
+ * The engines hand over all coefficients at once, so the first coefficient
+ * arrives with the result. A burst superseded by a newer one before its
+ * result is abandoned, as that result is never shown.
+ *
+ * Latencies are kept in histograms whose buckets grow with the value, as in
+ * HdrHistogram: values keep two significant digits from a microsecond to
+ * hours, in a fixed amount of memory, so that percentiles stay exact enough
+ * however long the session.
+ */
+#include "raylib/raylib.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HISTOGRAM_SUB_BITS 7 // Values are kept to 1 part in 2^(bits-1)
+#define HISTOGRAM_HALF (1 << (HISTOGRAM_SUB_BITS - 1))
+#define HISTOGRAM_MAX_SHIFT 30 // Larger values are counted in the last bucket
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_SHIFT + 2) * HISTOGRAM_HALF)
+
+/* Counts of values in microseconds */
+typedef struct {
+  long long counts[HISTOGRAM_BUCKETS];
+  long long total;
+  long long min, max;
+} Histogram;
+
+/* Values below 2 * HISTOGRAM_HALF have a bucket each. Above, each power of
+two is split into HISTOGRAM_HALF buckets. */
+int _histogram_bucket(long long value) {
+  int shift = 0;
+  while ((value >> shift) >= 2 * HISTOGRAM_HALF)
+    shift++;
+  if (shift > HISTOGRAM_MAX_SHIFT)
+    return HISTOGRAM_BUCKETS - 1;
+  return shift * HISTOGRAM_HALF + (value >> shift);
+}
+
+/* The largest value counted in bucket */
+long long _histogram_bucket_max(int bucket) {
+  if (bucket < 2 * HISTOGRAM_HALF)
+    return bucket;
+  int shift = bucket / HISTOGRAM_HALF - 1;
+  return ((long long)(bucket - shift * HISTOGRAM_HALF + 1) << shift) - 1;
+}
+
+void histogram_record(Histogram *h, double seconds) {
+  long long value = llround(seconds * 1e6);
+  if (value < 0)
+    value = 0;
+  h->counts[_histogram_bucket(value)]++;
+  if (h->total == 0 || value < h->min)
+    h->min = value;
+  if (h->total == 0 || value > h->max)
+    h->max = value;
+  h->total++;
+}
+
+/* The value in seconds that percentile percent of the values do not exceed,
+up to the precision of the buckets */
+double histogram_percentile(Histogram *h, double percent) {
+  if (h->total == 0)
+    return 0;
+  long long rank = ceil(percent / 100 * h->total);
+  if (rank < 1)
+    rank = 1;
+  long long seen = 0;
+  for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+    seen += h->counts[bucket];
+    if (seen >= rank) {
+      long long value = _histogram_bucket_max(bucket);
+      return (value < h->max ? value : h->max) / 1e6;
+    }
+  }
+  return h->max / 1e6;
+}
+
+typedef enum {
+  LATENCY_PROGRESS,
+  LATENCY_RESULT,
+  LATENCY_SHOWN,
+  LATENCY_COUNT
+} LatencyMilestone;
+
+const char *latency_milestone_names[] = {"progress", "result", "shown"};
+
+typedef struct {
+  Histogram histograms[LATENCY_COUNT];
+  int job_id;       // Foreground job of the burst being timed, or -1
+  double edit_time; // When its first edit happened
+  bool reached[LATENCY_COUNT];
+} LatencyTracker;
+
+void latency_init(LatencyTracker *t) {
+  memset(t, 0, sizeof(*t));
+  t->job_id = -1;
+}
+
+/* Time the burst of edits that started at edit_time and was handed over as
+job job_id, abandoning the one timed until now */
+void latency_start(LatencyTracker *t, int job_id, double edit_time) {
+  t->job_id = job_id;
+  t->edit_time = edit_time;
+  memset(t->reached, 0, sizeof(t->reached));
+}
+
+/* Is milestone still to be reached by the burst being timed? Milestones are
+reached in order, so one that was passed over will not be. */
+bool latency_pending(LatencyTracker *t, LatencyMilestone milestone) {
+  if (t->job_id < 0)
+    return false;
+  for (int m = milestone; m < LATENCY_COUNT; m++) {
+    if (t->reached[m])
+      return false;
+  }
+  return true;
+}
+
+/* Record that the burst being timed reached milestone at time */
+void latency_reach(LatencyTracker *t, LatencyMilestone milestone, double time) {
+  if (!latency_pending(t, milestone))
+    return;
+  t->reached[milestone] = true;
+  histogram_record(&t->histograms[milestone], time - t->edit_time);
+  if (milestone == LATENCY_COUNT - 1)
+    t->job_id = -1;
+}
+
+/* Draw the count and percentiles of each milestone, on one row each */
+void latency_draw(LatencyTracker *t, Font font, Vector2 position, float size) {
+  for (int m = 0; m < LATENCY_COUNT; m++) {
+    Histogram *h = &t->histograms[m];
+    char line[128];
+    snprintf(line, sizeof(line),
+             "%s: %lld, p50 %.1f, p90 %.1f, p99 %.1f, max %.1f ms",
+             latency_milestone_names[m], h->total,
+             1e3 * histogram_percentile(h, 50),
+             1e3 * histogram_percentile(h, 90),
+             1e3 * histogram_percentile(h, 99), h->max / 1e3);
+    DrawTextEx(font, line, (Vector2){position.x, position.y + m * size * 1.25},
+               size, 0.0, DARKGRAY);
+  }
+}
+
+/* Print a table of the percentiles of each milestone to out, in
+milliseconds, unless no burst was timed */
+void latency_print(LatencyTracker *t, FILE *out) {
+  double percents[] = {50, 90, 99, 99.9};
+  int percent_count = sizeof(percents) / sizeof(percents[0]);
+  bool any = false;
+  for (int m = 0; m < LATENCY_COUNT; m++)
+    any |= t->histograms[m].total > 0;
+  if (!any)
+    return;
+  fprintf(out, "Latency from edit (ms)\n%-10s %8s", "milestone", "count");
+  for (int i = 0; i < percent_count; i++) {
+    char label[16];
+    snprintf(label, sizeof(label), "p%g", percents[i]);
+    fprintf(out, " %9s", label);
+  }
+  fprintf(out, " %9s %9s\n", "min", "max");
+  for (int m = 0; m < LATENCY_COUNT; m++) {
+    Histogram *h = &t->histograms[m];
+    fprintf(out, "%-10s %8lld", latency_milestone_names[m], h->total);
+    for (int i = 0; i < percent_count; i++)
+      fprintf(out, " %9.2f", 1e3 * histogram_percentile(h, percents[i]));
+    fprintf(out, " %9.2f %9.2f\n", h->min / 1e3, h->max / 1e3);
+  }
+}
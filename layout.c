@@ -0,0 +1,525 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Force-directed layout, for graphs that come without coordinates.
+ * Every iteration, edges pull their endpoints together and all nodes push
+ * each other apart (Fruchterman-Reingold). The repulsion between all pairs is
+ * approximated with a Barnes-Hut quadtree: a far away group of nodes acts as a
+ * single node at its center of mass, which makes an iteration O(n log n). The
+ * repulsion is computed by several threads, each over its own range of nodes.
+ * Every node moves along its net force by the same step length, which adapts
+ * to progress (Hu's scheme): it shrinks whenever the total energy goes up, and
+ * grows again after a few iterations of steady decrease. The layout stops
+ * once the step is a small fraction of the ideal edge length.
+ *
+ * On its own that untangles large graphs slowly, so the layout is multilevel:
+ * the graph is repeatedly coarsened by merging the endpoints of a maximal
+ * matching, the coarsest graph is laid out first, and each finer level starts
+ * from the layout of the level above, where it only needs local refinement.
+ *
+ * The layout runs on its own thread, not in the job pool, so it never holds
+ * up a polynomial. After every iteration it publishes the positions, centered
+ * on the origin, into a front buffer, which the render loop takes whenever it
+ * is fresh.
+ *
+ * Included from chrompoly.c after scheduler.c, for Edge and cmp_edge.
+ */
+#include "array.h"
+#include "trace.h"
+#include <math.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#define LAYOUT_THETA 0.8      // Barnes-Hut opening criterion
+#define LAYOUT_COOLING 0.98   // Step factor when the energy goes up
+#define LAYOUT_PATIENCE 5     // Iterations of progress before the step grows
+#define LAYOUT_TOLERANCE 0.01 // Stop when the step is this times ideal length
+#define LAYOUT_MAX_ITERATIONS 500 // On the coarsest level
+#define LAYOUT_REFINE_ITERATIONS 150 // On the other levels
+#define LAYOUT_COARSEST 50        // Stop coarsening below this many nodes
+#define LAYOUT_REPULSION 0.2  // Relative strength of repulsion to attraction
+#define LAYOUT_GRAVITY 0.002  // Pull towards the origin, keeps components close
+#define QUAD_MAX_DEPTH 32
+
+typedef struct {
+  float x0, y0, size; // Square covered by the cell
+  float mass;         // Nodes in the cell
+  float cx, cy;       // Center of mass
+  int body;           // The only node in a leaf, -1 otherwise
+  int child[4];       // -1 if absent
+} QuadCell;
+array_def(QuadCell, quad_cell);
+
+/* The graph at one level of coarsening. Level 0 is the input graph. */
+typedef struct {
+  int n;
+  array_edge edges;
+  array_int parent;      // Node -> node of the next coarser level
+  array_int of_original; // Node of the input graph -> node of this level
+} LayoutLevel;
+array_def(LayoutLevel, layout_level);
+
+typedef struct {
+  int node_count; // Of the input graph
+  array_layout_level levels;
+  float ideal_length;
+  float step;
+  float energy; // Sum of the squared forces in the last iteration
+  int progress; // Iterations in a row that lowered the energy
+  int thread_count;
+
+  // Working state, only touched by the layout threads
+  int level; // Level being laid out
+  int n;     // Its number of nodes
+  array_edge *edges;
+  float *x, *y, *dx, *dy;
+  float *coarse_x, *coarse_y; // Layout of the level above
+  array_quad_cell tree;
+
+  mtx_t mutex; // Guards front and fresh
+  float *front; // x0, y0, x1, y1, ...
+  bool fresh;
+
+  thrd_t thread;
+  void (*thread_start)(const char *role); // Called first by thread, or NULL
+  bool started;
+  volatile bool stop;
+  volatile bool done;
+  volatile int iterations;
+} Layout;
+
+int _quad_new_cell(array_quad_cell *tree, float x0, float y0, float size) {
+  QuadCell cell = {x0, y0, size, 0, 0, 0, -1, {-1, -1, -1, -1}};
+  array_add(tree, cell);
+  return array_size(tree) - 1;
+}
+
+int _quadrant(QuadCell *cell, float x, float y) {
+  float half = cell->size / 2;
+  return (x >= cell->x0 + half) + 2 * (y >= cell->y0 + half);
+}
+
+/* Insert node i, at (x, y), into the subtree of cell c */
+void _quad_insert(Layout *l, int c, int i, int depth) {
+  float x = l->x[i], y = l->y[i];
+  while (true) {
+    QuadCell *cell = &array_at(&l->tree, c);
+    cell->cx = (cell->cx * cell->mass + x) / (cell->mass + 1);
+    cell->cy = (cell->cy * cell->mass + y) / (cell->mass + 1);
+    cell->mass++;
+    if (cell->mass == 1) {
+      cell->body = i;
+      return;
+    }
+    // Nodes at (almost) the same position just share a leaf
+    if (depth >= QUAD_MAX_DEPTH) {
+      cell->body = -1;
+      return;
+    }
+    if (cell->body >= 0) {
+      // Push the node already here one level down
+      int other = cell->body;
+      cell->body = -1;
+      int q = _quadrant(cell, l->x[other], l->y[other]);
+      float half = cell->size / 2;
+      int child = _quad_new_cell(&l->tree, cell->x0 + (q & 1) * half,
+                                 cell->y0 + (q >> 1) * half, half);
+      cell = &array_at(&l->tree, c); // The tree may have moved
+      cell->child[q] = child;
+      QuadCell *moved = &array_at(&l->tree, child);
+      moved->mass = 1;
+      moved->cx = l->x[other];
+      moved->cy = l->y[other];
+      moved->body = other;
+    }
+    int q = _quadrant(cell, x, y);
+    if (cell->child[q] < 0) {
+      float half = cell->size / 2;
+      int child = _quad_new_cell(&l->tree, cell->x0 + (q & 1) * half,
+                                 cell->y0 + (q >> 1) * half, half);
+      array_at(&l->tree, c).child[q] = child;
+    }
+    c = array_at(&l->tree, c).child[q];
+    depth++;
+  }
+}
+
+void _quad_build(Layout *l) {
+  float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+  for (int i = 0; i < l->n; i++) {
+    x0 = fminf(x0, l->x[i]);
+    y0 = fminf(y0, l->y[i]);
+    x1 = fmaxf(x1, l->x[i]);
+    y1 = fmaxf(y1, l->y[i]);
+  }
+  array_clear(&l->tree);
+  _quad_new_cell(&l->tree, x0, y0, fmaxf(x1 - x0, y1 - y0) + 1);
+  for (int i = 0; i < l->n; i++)
+    _quad_insert(l, 0, i, 0);
+}
+
+/* Add the repulsion on node i from every other node to dx[i], dy[i] */
+void _repulse(Layout *l, int i) {
+  float k2 = LAYOUT_REPULSION * l->ideal_length * l->ideal_length;
+  float x = l->x[i], y = l->y[i];
+  int stack[4 * QUAD_MAX_DEPTH + 4];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    QuadCell *cell = &array_at(&l->tree, stack[--top]);
+    if (cell->mass == 0 || cell->body == i)
+      continue;
+    float ddx = x - cell->cx, ddy = y - cell->cy;
+    float d2 = ddx * ddx + ddy * ddy;
+    bool leaf = cell->child[0] < 0 && cell->child[1] < 0 &&
+                cell->child[2] < 0 && cell->child[3] < 0;
+    if (leaf || cell->size * cell->size < LAYOUT_THETA * LAYOUT_THETA * d2) {
+      if (d2 < 0.01) {
+        // Coincident nodes: push apart in an arbitrary but fixed direction
+        ddx = (i % 7) - 3 + 0.5;
+        ddy = (i % 5) - 2 + 0.5;
+        d2 = ddx * ddx + ddy * ddy;
+      }
+      // Force k^2 / d along the unit vector, i.e. k^2 / d^2 times (ddx, ddy)
+      float mass = cell->mass;
+      // A leaf shared at max depth may contain node i itself
+      if (leaf && cell->body < 0 && cell->x0 <= x && x < cell->x0 + cell->size &&
+          cell->y0 <= y && y < cell->y0 + cell->size)
+        mass--;
+      float f = mass * k2 / d2;
+      l->dx[i] += ddx * f;
+      l->dy[i] += ddy * f;
+      continue;
+    }
+    for (int q = 0; q < 4; q++)
+      if (cell->child[q] >= 0)
+        stack[top++] = cell->child[q];
+  }
+}
+
+typedef struct {
+  Layout *layout;
+  int lo, hi;
+} RepulseRange;
+
+int _repulse_range(void *arg) {
+  RepulseRange *range = arg;
+  for (int i = range->lo; i < range->hi; i++)
+    _repulse(range->layout, i);
+  return 0;
+}
+
+void _layout_iteration(Layout *l) {
+  _quad_build(l);
+  memset(l->dx, 0, l->n * sizeof(float));
+  memset(l->dy, 0, l->n * sizeof(float));
+
+  // Repulsion, split over the threads. The calling thread takes the first
+  // range itself.
+  int threads = l->thread_count < l->n ? l->thread_count : 1;
+  RepulseRange ranges[threads];
+  thrd_t helpers[threads];
+  for (int t = 0; t < threads; t++)
+    ranges[t] = (RepulseRange){l, l->n * t / threads, l->n * (t + 1) / threads};
+  for (int t = 1; t < threads; t++) {
+    if (thrd_create(&helpers[t], _repulse_range, &ranges[t]) != thrd_success) {
+      _repulse_range(&ranges[t]);
+      helpers[t] = 0;
+      ranges[t].hi = ranges[t].lo = -1;
+    }
+  }
+  _repulse_range(&ranges[0]);
+  for (int t = 1; t < threads; t++)
+    if (ranges[t].lo >= 0)
+      thrd_join(helpers[t], NULL);
+
+  // Attraction d^2 / k along each edge
+  array_foreach(l->edges, Edge edge) {
+    int a = edge.start_idx, b = edge.end_idx;
+    float ddx = l->x[a] - l->x[b], ddy = l->y[a] - l->y[b];
+    float d = sqrtf(ddx * ddx + ddy * ddy);
+    float f = d / l->ideal_length;
+    l->dx[a] -= ddx * f;
+    l->dy[a] -= ddy * f;
+    l->dx[b] += ddx * f;
+    l->dy[b] += ddy * f;
+  }
+
+  float energy = 0;
+  for (int i = 0; i < l->n; i++) {
+    float fx = l->dx[i] - LAYOUT_GRAVITY * l->x[i];
+    float fy = l->dy[i] - LAYOUT_GRAVITY * l->y[i];
+    float f2 = fx * fx + fy * fy;
+    energy += f2;
+    if (f2 > 0) {
+      float f = sqrtf(f2);
+      l->x[i] += l->step * fx / f;
+      l->y[i] += l->step * fy / f;
+    }
+  }
+
+  if (l->progress >= 0 && energy >= l->energy) {
+    l->progress = 0;
+    l->step *= LAYOUT_COOLING;
+  } else if (++l->progress >= LAYOUT_PATIENCE) {
+    l->progress = 0;
+    l->step = fminf(l->step / LAYOUT_COOLING, 2 * l->ideal_length);
+  }
+  l->energy = energy;
+}
+
+/*
+ * Copy the positions into the front buffer, each node of the input graph at
+ * the position of the node it is merged into at the current level. Repulsion
+ * between all pairs makes large graphs spread out, so the positions are scaled
+ * around their centroid to make the mean edge length the ideal length.
+ */
+void _layout_publish(Layout *l) {
+  float cx = 0, cy = 0, total = 0;
+  for (int i = 0; i < l->n; i++) {
+    cx += l->x[i] / l->n;
+    cy += l->y[i] / l->n;
+  }
+  array_foreach(l->edges, Edge edge) {
+    float ddx = l->x[edge.start_idx] - l->x[edge.end_idx];
+    float ddy = l->y[edge.start_idx] - l->y[edge.end_idx];
+    total += sqrtf(ddx * ddx + ddy * ddy);
+  }
+  float scale = 1;
+  if (total > 0)
+    scale = l->ideal_length * array_size(l->edges) / total;
+
+  array_int *of_original = &array_at(&l->levels, l->level).of_original;
+  mtx_lock(&l->mutex);
+  for (int i = 0; i < l->node_count; i++) {
+    int v = array_at(of_original, i);
+    l->front[2 * i] = (l->x[v] - cx) * scale;
+    l->front[2 * i + 1] = (l->y[v] - cy) * scale;
+  }
+  l->fresh = true;
+  mtx_unlock(&l->mutex);
+}
+
+/*
+ * Build the next coarser level of fine by merging each node with one of its
+ * unmatched neighbours, if any. Returns false, leaving coarse uninitialised,
+ * if that would barely shrink the graph (e.g. a star).
+ */
+bool _coarsen(LayoutLevel *fine, LayoutLevel *coarse) {
+  int n = fine->n;
+  // Adjacency in compressed form: neighbours of v at [start[v], start[v + 1])
+  int *start = calloc(n + 1, sizeof(int));
+  int *neighbours = malloc(2 * array_size(&fine->edges) * sizeof(int) + 1);
+  array_foreach(&fine->edges, Edge edge) {
+    start[edge.start_idx + 1]++;
+    start[edge.end_idx + 1]++;
+  }
+  for (int v = 0; v < n; v++)
+    start[v + 1] += start[v];
+  int *fill = malloc((n + 1) * sizeof(int));
+  memcpy(fill, start, (n + 1) * sizeof(int));
+  array_foreach(&fine->edges, Edge edge) {
+    neighbours[fill[edge.start_idx]++] = edge.end_idx;
+    neighbours[fill[edge.end_idx]++] = edge.start_idx;
+  }
+
+  array_init(&fine->parent);
+  for (int v = 0; v < n; v++)
+    array_add(&fine->parent, -1);
+  // Visit the nodes in random order: in index order, graphs like grids would
+  // always merge along the same direction and coarsen into long strips
+  int *order = malloc(n * sizeof(int) + 1);
+  unsigned int seed = n;
+  for (int v = 0; v < n; v++) {
+    int j = (seed = seed * 1103515245 + 12345) % (v + 1);
+    order[v] = order[j];
+    order[j] = v;
+  }
+  int m = 0;
+  for (int k = 0; k < n; k++) {
+    int v = order[k];
+    if (array_at(&fine->parent, v) >= 0)
+      continue;
+    array_at(&fine->parent, v) = m;
+    for (int j = start[v]; j < start[v + 1]; j++) {
+      if (array_at(&fine->parent, neighbours[j]) < 0) {
+        array_at(&fine->parent, neighbours[j]) = m;
+        break;
+      }
+    }
+    m++;
+  }
+  free(start);
+  free(neighbours);
+  free(fill);
+  free(order);
+  if (m > 0.8 * n) {
+    array_term(&fine->parent);
+    return false;
+  }
+
+  coarse->n = m;
+  array_init(&coarse->parent);
+  array_init(&coarse->edges);
+  array_foreach(&fine->edges, Edge edge) {
+    int a = array_at(&fine->parent, edge.start_idx);
+    int b = array_at(&fine->parent, edge.end_idx);
+    if (a != b)
+      array_add(&coarse->edges, ((Edge){a < b ? a : b, a < b ? b : a}));
+  }
+  // Merged edges become parallel: keep one of each
+  array_sort(&coarse->edges, cmp_edge);
+  int kept = 0;
+  array_enumerate(&coarse->edges, i, Edge edge) {
+    if (kept == 0 || !edge_eq(edge, array_at(&coarse->edges, kept - 1)))
+      array_at(&coarse->edges, kept++) = edge;
+  }
+  coarse->edges.size = kept;
+  array_init(&coarse->of_original);
+  array_foreach(&fine->of_original, int v) {
+    array_add(&coarse->of_original, array_at(&fine->parent, v));
+  }
+  return true;
+}
+
+/* Lay out the given level, starting from the positions in x and y */
+void _layout_level(Layout *l, int level) {
+  LayoutLevel *lvl = &array_at(&l->levels, level);
+  l->level = level;
+  l->n = lvl->n;
+  l->edges = &lvl->edges;
+  l->step = l->ideal_length;
+  l->progress = -1; // No energy to compare to yet
+  int max_iterations = level == array_size(&l->levels) - 1
+                           ? LAYOUT_MAX_ITERATIONS
+                           : LAYOUT_REFINE_ITERATIONS;
+  for (int i = 0; i < max_iterations && !l->stop &&
+                  l->step > LAYOUT_TOLERANCE * l->ideal_length;
+       i++) {
+    _layout_iteration(l);
+    l->iterations++;
+    _layout_publish(l);
+  }
+}
+
+int _layout_thread(void *arg) {
+  Layout *l = arg;
+  // The threads helping with repulsion inherit the placement of this one
+  if (l->thread_start != NULL)
+    l->thread_start("layout");
+  TRACE_BEGIN("layout.coarsen");
+  while (array_size(&l->levels) < 32 &&
+         array_last(&l->levels).n > LAYOUT_COARSEST) {
+    LayoutLevel coarse;
+    if (!_coarsen(&array_last(&l->levels), &coarse))
+      break;
+    array_add(&l->levels, coarse);
+  }
+  TRACE_END("layout.coarsen");
+
+  // The coarsest level starts from the initial positions of any of the nodes
+  // merged into each of its nodes
+  int top = array_size(&l->levels) - 1;
+  array_enumerate(&array_at(&l->levels, top).of_original, i, int v) {
+    l->x[v] = l->coarse_x[i];
+    l->y[v] = l->coarse_y[i];
+  }
+  for (int level = top; level >= 0 && !l->stop; level--) {
+    if (level < top) {
+      // Start each node next to the node it was merged into
+      array_int *parent = &array_at(&l->levels, level).parent;
+      memcpy(l->coarse_x, l->x, l->n * sizeof(float));
+      memcpy(l->coarse_y, l->y, l->n * sizeof(float));
+      for (int v = 0; v < array_size(parent); v++) {
+        int p = array_at(parent, v);
+        l->x[v] = l->coarse_x[p] + (v % 3 - 1) * l->ideal_length / 4;
+        l->y[v] = l->coarse_y[p] + (v % 5 - 2) * l->ideal_length / 8;
+      }
+    }
+    TRACE_BEGIN("layout.level");
+    _layout_level(l, level);
+    TRACE_END("layout.level");
+  }
+  l->done = true;
+  return 0;
+}
+
+/*
+ * Start laying out the graph with n nodes, starting from the positions xy
+ * (x0, y0, x1, y1, ...). Edges should be about ideal_length long. The layout
+ * thread first calls thread_start("layout"), unless it is NULL.
+ */
+void layout_start(Layout *l, int n, array_edge *edges, float *xy,
+                  float ideal_length, int thread_count,
+                  void (*thread_start)(const char *role)) {
+  memset(l, 0, sizeof(*l));
+  l->thread_start = thread_start;
+  l->node_count = n;
+  LayoutLevel input = {.n = n};
+  array_init(&input.edges);
+  array_init(&input.parent);
+  array_init(&input.of_original);
+  array_foreach(edges, Edge edge) { array_add(&input.edges, edge); }
+  for (int i = 0; i < n; i++)
+    array_add(&input.of_original, i);
+  array_init(&l->levels);
+  array_add(&l->levels, input);
+  l->ideal_length = ideal_length;
+  l->thread_count = thread_count > 0 ? thread_count : 1;
+  l->x = malloc(n * sizeof(float) + 1);
+  l->y = malloc(n * sizeof(float) + 1);
+  l->dx = malloc(n * sizeof(float) + 1);
+  l->dy = malloc(n * sizeof(float) + 1);
+  l->coarse_x = malloc(n * sizeof(float) + 1);
+  l->coarse_y = malloc(n * sizeof(float) + 1);
+  l->front = malloc(2 * n * sizeof(float) + 1);
+  for (int i = 0; i < n; i++) {
+    l->coarse_x[i] = xy[2 * i];
+    l->coarse_y[i] = xy[2 * i + 1];
+  }
+  array_init(&l->tree);
+  mtx_init(&l->mutex, mtx_plain);
+  if (thrd_create(&l->thread, _layout_thread, l) == thrd_success)
+    l->started = true;
+  else
+    l->done = true;
+}
+
+/* If the layout has published positions since the last call, copy them into
+xy and return true */
+bool layout_take(Layout *l, float *xy) {
+  if (!l->started)
+    return false;
+  mtx_lock(&l->mutex);
+  bool fresh = l->fresh;
+  if (fresh)
+    memcpy(xy, l->front, 2 * l->node_count * sizeof(float));
+  l->fresh = false;
+  mtx_unlock(&l->mutex);
+  return fresh;
+}
+
+/* Stop the layout, if still running, and free it */
+void layout_term(Layout *l) {
+  if (l->started) {
+    l->stop = true;
+    thrd_join(l->thread, NULL);
+    mtx_destroy(&l->mutex);
+  }
+  array_foreach(&l->levels, LayoutLevel level) {
+    array_term(&level.edges);
+    array_term(&level.parent);
+    array_term(&level.of_original);
+  }
+  array_term(&l->levels);
+  array_term(&l->tree);
+  free(l->coarse_x);
+  free(l->coarse_y);
+  free(l->x);
+  free(l->y);
+  free(l->dx);
+  free(l->dy);
+  free(l->front);
+  memset(l, 0, sizeof(*l));
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Vertex relabeling applied before a graph is handed to an engine.
+ * Vertices arrive numbered in the order they were clicked on the canvas, which
+ * is arbitrary. An ordering here is returned as a permutation perm, where
+ * perm[v] is the new label of vertex v.
+ *
+ * Included from chrompoly.c after submap.c, for the Edge type.
+ */
+#include "array.h"
+#include <stdio.h>
+
+typedef enum {
+  ORDERING_NONE,
+  ORDERING_DEGENERACY, // Repeatedly remove a vertex of minimum degree
+  ORDERING_RCM,        // Reverse Cuthill-McKee, to minimise bandwidth
+  ORDERING_MIN_FILL,   // Eliminate the vertex adding the fewest fill edges
+} VertexOrdering;
+
+const char *ordering_names[] = {"none", "degeneracy", "rcm", "minfill"};
+
+/* Parse an ordering name as accepted in CHROMPOLY_ORDERING.
+Returns fallback if name is NULL or not recognised. */
+VertexOrdering parse_vertex_ordering(const char *name,
+                                     VertexOrdering fallback) {
+  if (name == NULL)
+    return fallback;
+  for (int i = 0; i < sizeof(ordering_names) / sizeof(char *); i++) {
+    if (strcmp(name, ordering_names[i]) == 0)
+      return i;
+  }
+  printf("Unknown vertex ordering '%s', using %s\n", name,
+         ordering_names[fallback]);
+  return fallback;
+}
+
+/* n x n adjacency matrix as a flat array of bools. The caller frees it. */
+bool *_adjacency_matrix(int n, array_edge *edges) {
+  bool *adj = calloc((size_t)n * n, sizeof(bool));
+  array_foreach(edges, Edge edge) {
+    adj[(size_t)edge.start_idx * n + edge.end_idx] = true;
+    adj[(size_t)edge.end_idx * n + edge.start_idx] = true;
+  }
+  return adj;
+}
+
+/* Adjacency lists: the neighbours of v are (*neighbours)[(*first)[v]] up to
+(*first)[v + 1]. The caller frees both. */
+void _adjacency_lists(int n, array_edge *edges, int **first,
+                      int **neighbours) {
+  *first = calloc(n + 1, sizeof(int));
+  *neighbours = malloc(2 * array_size(edges) * sizeof(int));
+  array_foreach(edges, Edge edge) {
+    (*first)[edge.start_idx + 1]++;
+    (*first)[edge.end_idx + 1]++;
+  }
+  for (int v = 0; v < n; v++)
+    (*first)[v + 1] += (*first)[v];
+  int *next = malloc((n + 1) * sizeof(int));
+  memcpy(next, *first, (n + 1) * sizeof(int));
+  array_foreach(edges, Edge edge) {
+    (*neighbours)[next[edge.start_idx]++] = edge.end_idx;
+    (*neighbours)[next[edge.end_idx]++] = edge.start_idx;
+  }
+  free(next);
+}
+
+/* Turn a list of vertices in visiting order into perm[v] = position of v */
+array_int _order_to_permutation(int *order, int n) {
+  array_int perm;
+  array_init(&perm);
+  for (int i = 0; i < n; i++)
+    array_add(&perm, 0);
+  for (int i = 0; i < n; i++)
+    array_at(&perm, order[i]) = i;
+  return perm;
+}
+
+/* Vertices by their degree in what is left of a graph: those of degree d form
+a doubly linked list from head[d] */
+typedef struct {
+  int *degree;
+  int *head;
+  int *next;
+  int *prev;
+} DegreeBuckets;
+
+void _buckets_push(DegreeBuckets *b, int v) {
+  int d = b->degree[v];
+  b->prev[v] = -1;
+  b->next[v] = b->head[d];
+  if (b->head[d] >= 0)
+    b->prev[b->head[d]] = v;
+  b->head[d] = v;
+}
+
+void _buckets_remove(DegreeBuckets *b, int v) {
+  if (b->prev[v] >= 0)
+    b->next[b->prev[v]] = b->next[v];
+  else
+    b->head[b->degree[v]] = b->next[v];
+  if (b->next[v] >= 0)
+    b->prev[b->next[v]] = b->prev[v];
+}
+
+/* Repeatedly remove a vertex of minimum degree, in O(n + m): the search for
+the next one starts from the lowest degree that a neighbour dropped to */
+array_int degeneracy_ordering(int n, array_edge *edges) {
+  int *first, *neighbours;
+  _adjacency_lists(n, edges, &first, &neighbours);
+  int max_degree = 0;
+  for (int v = 0; v < n; v++) {
+    if (first[v + 1] - first[v] > max_degree)
+      max_degree = first[v + 1] - first[v];
+  }
+  DegreeBuckets b = {malloc(n * sizeof(int)),
+                     malloc((max_degree + 1) * sizeof(int)),
+                     malloc(n * sizeof(int)), malloc(n * sizeof(int))};
+  for (int d = 0; d <= max_degree; d++)
+    b.head[d] = -1;
+  for (int v = 0; v < n; v++) {
+    b.degree[v] = first[v + 1] - first[v];
+    _buckets_push(&b, v);
+  }
+  bool *removed = calloc(n, sizeof(bool));
+  int *order = malloc(n * sizeof(int));
+  int low = 0;
+  for (int i = 0; i < n; i++) {
+    while (b.head[low] < 0)
+      low++;
+    int v = b.head[low];
+    _buckets_remove(&b, v);
+    removed[v] = true;
+    order[i] = v;
+    for (int j = first[v]; j < first[v + 1]; j++) {
+      int u = neighbours[j];
+      if (removed[u])
+        continue;
+      _buckets_remove(&b, u);
+      b.degree[u]--;
+      _buckets_push(&b, u);
+      if (b.degree[u] < low)
+        low = b.degree[u];
+    }
+  }
+  array_int perm = _order_to_permutation(order, n);
+  free(first);
+  free(neighbours);
+  free(b.degree);
+  free(b.head);
+  free(b.next);
+  free(b.prev);
+  free(removed);
+  free(order);
+  return perm;
+}
+
+array_int rcm_ordering(int n, array_edge *edges) {
+  int *first, *neighbours;
+  _adjacency_lists(n, edges, &first, &neighbours);
+  bool *visited = calloc(n, sizeof(bool));
+  int *order = malloc(n * sizeof(int));
+  int *degree = malloc(n * sizeof(int));
+  for (int v = 0; v < n; v++)
+    degree[v] = first[v + 1] - first[v];
+  int len = 0;
+
+  // Breadth first search from a minimum degree vertex of each component,
+  // visiting neighbours in order of increasing degree
+  while (len < n) {
+    int start = -1;
+    for (int v = 0; v < n; v++) {
+      if (!visited[v] && (start < 0 || degree[v] < degree[start]))
+        start = v;
+    }
+    visited[start] = true;
+    order[len++] = start;
+    for (int head = len - 1; head < len; head++) {
+      int v = order[head];
+      int queued = len;
+      for (int j = first[v]; j < first[v + 1]; j++) {
+        int u = neighbours[j];
+        if (!visited[u]) {
+          visited[u] = true;
+          order[len++] = u;
+        }
+      }
+      // Insertion sort the newly queued neighbours by degree
+      for (int i = queued + 1; i < len; i++) {
+        int u = order[i], d = degree[u];
+        int j = i;
+        for (; j > queued && degree[order[j - 1]] > d; j--)
+          order[j] = order[j - 1];
+        order[j] = u;
+      }
+    }
+  }
+
+  // Reverse the Cuthill-McKee order
+  for (int i = 0; i < n / 2; i++) {
+    int t = order[i];
+    order[i] = order[n - 1 - i];
+    order[n - 1 - i] = t;
+  }
+  array_int perm = _order_to_permutation(order, n);
+  free(first);
+  free(neighbours);
+  free(visited);
+  free(order);
+  free(degree);
+  return perm;
+}
+
+array_int min_fill_ordering(int n, array_edge *edges) {
+  bool *adj = _adjacency_matrix(n, edges);
+  bool *removed = calloc(n, sizeof(bool));
+  int *order = malloc(n * sizeof(int));
+  for (int i = 0; i < n; i++) {
+    int best = -1, best_fill = 0;
+    for (int v = 0; v < n; v++) {
+      if (removed[v])
+        continue;
+      // Count pairs of remaining neighbours of v that are not yet adjacent
+      int fill = 0;
+      for (int a = 0; a < n; a++) {
+        if (removed[a] || !adj[(size_t)v * n + a])
+          continue;
+        for (int b = a + 1; b < n; b++)
+          fill += !removed[b] && adj[(size_t)v * n + b] &&
+                  !adj[(size_t)a * n + b];
+      }
+      if (best < 0 || fill < best_fill) {
+        best = v;
+        best_fill = fill;
+      }
+    }
+    // Eliminate best: its remaining neighbours become a clique
+    for (int a = 0; a < n; a++) {
+      if (removed[a] || !adj[(size_t)best * n + a])
+        continue;
+      for (int b = 0; b < n; b++) {
+        if (b != a && !removed[b] && adj[(size_t)best * n + b])
+          adj[(size_t)a * n + b] = true;
+      }
+    }
+    removed[best] = true;
+    order[i] = best;
+  }
+  array_int perm = _order_to_permutation(order, n);
+  free(adj);
+  free(removed);
+  free(order);
+  return perm;
+}
+
+array_int vertex_ordering(VertexOrdering ordering, int n, array_edge *edges) {
+  switch (ordering) {
+  case ORDERING_DEGENERACY:
+    return degeneracy_ordering(n, edges);
+  case ORDERING_RCM:
+    return rcm_ordering(n, edges);
+  case ORDERING_MIN_FILL:
+    return min_fill_ordering(n, edges);
+  default: {
+    array_int perm;
+    array_init(&perm);
+    for (int i = 0; i < n; i++)
+      array_add(&perm, i);
+    return perm;
+  }
+  }
+}
+
+/* Returns a copy of edges with every endpoint v renamed to perm[v] */
+array_edge permute_edges(array_edge *edges, array_int *perm) {
+  array_edge result;
+  array_init(&result);
+  array_foreach(edges, Edge edge) {
+    array_add(&result, ((Edge){array_at(perm, edge.start_idx),
+                               array_at(perm, edge.end_idx)}));
+  }
+  return result;
+}
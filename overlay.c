@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Text of the overlay, drawn once into a render texture and reused until what
+ * it shows changes. Laying out and drawing glyphs one by one is then only paid
+ * for when a result or a progress update arrives, not every frame.
+ *
+ * The owner numbers the versions of the content with a revision counter, and
+ * redraws between text_cache_begin() and text_cache_end() when asked to:
+ *
+ *   if (text_cache_begin(&cache, width, height, revision)) {
+ *     DrawTextEx(...);
+ *     text_cache_end(&cache);
+ *   }
+ *   text_cache_draw(&cache, position);
+ *
+ * The texture starts out transparent, and is drawn into with premultiplied
+ * alpha, so that antialiased glyph edges look the same as when drawn directly.
+ */
+#include "raylib/raylib.h"
+
+// Only raylib.h is vendored: declare the rlgl function and GL constants needed
+void rlSetBlendFactorsSeparate(int src_rgb, int dst_rgb, int src_alpha,
+                               int dst_alpha, int eq_rgb, int eq_alpha);
+#define GL_ONE 1
+#define GL_SRC_ALPHA 0x0302
+#define GL_ONE_MINUS_SRC_ALPHA 0x0303
+#define GL_FUNC_ADD 0x8006
+
+typedef struct {
+  RenderTexture2D texture;
+  bool valid;             // Has texture been drawn at least once?
+  unsigned long revision; // Revision of the content drawn into texture
+} TextCache;
+
+void text_cache_init(TextCache *cache) {
+  cache->texture = (RenderTexture2D){0};
+  cache->valid = false;
+  cache->revision = 0;
+}
+
+void text_cache_term(TextCache *cache) {
+  if (cache->texture.id != 0)
+    UnloadRenderTexture(cache->texture);
+}
+
+/* Returns true, with drawing redirected into the cache, if its content is not
+at revision or its size is not width x height. The caller then draws the
+content and calls text_cache_end(). */
+bool text_cache_begin(TextCache *cache, int width, int height,
+                      unsigned long revision) {
+  if (width < 1)
+    width = 1;
+  if (height < 1)
+    height = 1;
+  bool resized = cache->texture.texture.width != width ||
+                 cache->texture.texture.height != height;
+  if (cache->valid && !resized && cache->revision == revision)
+    return false;
+  if (resized) {
+    if (cache->texture.id != 0)
+      UnloadRenderTexture(cache->texture);
+    cache->texture = LoadRenderTexture(width, height);
+    SetTextureFilter(cache->texture.texture, TEXTURE_FILTER_POINT);
+  }
+  cache->valid = true;
+  cache->revision = revision;
+  BeginTextureMode(cache->texture);
+  ClearBackground(BLANK);
+  rlSetBlendFactorsSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                            GL_ONE_MINUS_SRC_ALPHA, GL_FUNC_ADD, GL_FUNC_ADD);
+  BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+  return true;
+}
+
+void text_cache_end(TextCache *cache) {
+  EndBlendMode();
+  EndTextureMode();
+}
+
+/* Draw the cached content with its top left corner at position */
+void text_cache_draw(TextCache *cache, Vector2 position) {
+  if (!cache->valid)
+    return;
+  Texture2D texture = cache->texture.texture;
+  // Render textures are stored upside down
+  BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+  DrawTextureRec(texture,
+                 (Rectangle){0, 0, texture.width, -(float)texture.height},
+                 position, WHITE);
+  EndBlendMode();
+}
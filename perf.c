@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Hardware and software performance counters of the engine phases, read
+ * through perf_event_open(2) on Linux.
+ * Setting CHROMPOLY_PERF to a file name (or "-" for stdout) appends one JSON
+ * object per line for each phase of each computed polynomial, e.g.
+ *
+ *   {"phase":"kernel.mobius","n":12,"m":20,"completed":true,
+ *    "seconds":0.0123,"cycles":41234567,"instructions":98765432,
+ *    "cache_misses":1234,"branch_misses":5678,"page_faults":12}
+ *
+ * Counters are opened per thread, the first time a thread measures a phase,
+ * and only count user space. A phase that helper threads share, such as
+ * delcon.expand, sums the counters of every thread, while its seconds are the
+ * wall time of the thread that steps it. A counter that the kernel does not
+ * provide, or does not let us open (see /proc/sys/kernel/perf_event_paranoid),
+ * is null, and the wall time is still reported.
+ *
+ * Included from chrompoly.c after submap.c, for engine_clock().
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+typedef enum {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_CACHE_MISSES,
+  PERF_BRANCH_MISSES,
+  PERF_PAGE_FAULTS,
+  PERF_COUNTER_COUNT
+} PerfCounter;
+
+const char *perf_counter_names[] = {"cycles", "instructions", "cache_misses",
+                                    "branch_misses", "page_faults"};
+
+/* Counts of one phase, accumulated over the steps it ran in */
+typedef struct {
+  bool ran;
+  double seconds;
+  bool counted[PERF_COUNTER_COUNT]; // Was the counter available?
+  long long counts[PERF_COUNTER_COUNT];
+  // At the start of the current step
+  double start_seconds;
+  long long start[PERF_COUNTER_COUNT];
+} PerfPhase;
+
+FILE *perf_output = NULL; // NULL when disabled
+mtx_t perf_mutex;         // Guards perf_warned and writes to perf_output
+bool perf_warned = false;
+
+// Counters of the calling thread, -1 where unavailable
+_Thread_local bool perf_opened = false;
+_Thread_local int perf_fds[PERF_COUNTER_COUNT];
+
+/* Enable reporting if CHROMPOLY_PERF is set. Returns false, after printing
+why, if its file cannot be opened. */
+bool perf_init() {
+  const char *path = getenv("CHROMPOLY_PERF");
+  if (path == NULL)
+    return true;
+  mtx_init(&perf_mutex, mtx_plain);
+  perf_output = strcmp(path, "-") == 0 ? stdout : fopen(path, "a");
+  if (perf_output == NULL) {
+    printf("Failed to open %s\n", path);
+    return false;
+  }
+  return true;
+}
+
+void perf_term() {
+  if (perf_output != NULL && perf_output != stdout)
+    fclose(perf_output);
+  perf_output = NULL;
+}
+
+void _perf_open() {
+  perf_opened = true;
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    perf_fds[i] = -1;
+#ifdef __linux__
+  struct {
+    unsigned type;
+    unsigned long long config;
+  } events[PERF_COUNTER_COUNT] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}};
+  char failed[256] = "";
+  int len = 0;
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[i].type;
+    attr.config = events[i].config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // This thread, on any CPU
+    perf_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (perf_fds[i] < 0 && len < sizeof(failed))
+      len += snprintf(failed + len, sizeof(failed) - len, " %s (%s)",
+                      perf_counter_names[i], strerror(errno));
+  }
+  mtx_lock(&perf_mutex);
+  if (len > 0 && !perf_warned)
+    printf("perf: counters unavailable, reported as null:%s\n", failed);
+  perf_warned |= len > 0;
+  mtx_unlock(&perf_mutex);
+#endif
+}
+
+long long _perf_read(int fd) {
+  long long value = 0;
+#ifdef __linux__
+  if (read(fd, &value, sizeof(value)) != sizeof(value))
+    value = 0;
+#endif
+  return value;
+}
+
+/* Start measuring a step of phase in the calling thread */
+void perf_phase_begin(PerfPhase *phase) {
+  if (perf_output == NULL)
+    return;
+  if (!perf_opened)
+    _perf_open();
+  phase->ran = true;
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    phase->counted[i] = perf_fds[i] >= 0;
+    if (phase->counted[i])
+      phase->start[i] = _perf_read(perf_fds[i]);
+  }
+  phase->start_seconds = engine_clock();
+}
+
+/* Add what happened since perf_phase_begin() to phase */
+void perf_phase_end(PerfPhase *phase) {
+  if (perf_output == NULL)
+    return;
+  phase->seconds += engine_clock() - phase->start_seconds;
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    if (phase->counted[i])
+      phase->counts[i] += _perf_read(perf_fds[i]) - phase->start[i];
+}
+
+/* Add the counts of from, measured in other threads, to phase. The seconds
+of phase stay its wall time. */
+void perf_phase_add(PerfPhase *phase, PerfPhase *from) {
+  if (!from->ran)
+    return;
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    if (phase->counted[i] && from->counted[i])
+      phase->counts[i] += from->counts[i];
+}
+
+/* Write the counts of phase, if it ran, as a line of JSON. n and m describe
+the graph, and completed whether the computation was not cancelled. */
+void perf_report(PerfPhase *phase, const char *name, int n, int m,
+                 bool completed) {
+  if (perf_output == NULL || !phase->ran)
+    return;
+  char line[512];
+  int len = snprintf(line, sizeof(line),
+                     "{\"phase\":\"%s\",\"n\":%d,\"m\":%d,\"completed\":%s,"
+                     "\"seconds\":%.9f",
+                     name, n, m, completed ? "true" : "false", phase->seconds);
+  for (int i = 0; i < PERF_COUNTER_COUNT && len < sizeof(line); i++) {
+    if (phase->counted[i])
+      len += snprintf(line + len, sizeof(line) - len, ",\"%s\":%lld",
+                      perf_counter_names[i], phase->counts[i]);
+    else
+      len += snprintf(line + len, sizeof(line) - len, ",\"%s\":null",
+                      perf_counter_names[i]);
+  }
+  mtx_lock(&perf_mutex);
+  fprintf(perf_output, "%s}\n", line);
+  fflush(perf_output);
+  mtx_unlock(&perf_mutex);
+}
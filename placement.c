@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Where the threads run: the size of the worker pool, the niceness and
+ * scheduling policy of the compute threads (workers and layout), and the CPUs
+ * that the compute threads and the UI thread may run on.
+ * Settings come from the environment and are overridden by the command line:
+ *
+ *   --workers N          CHROMPOLY_WORKERS      threads in the pool
+ *   --nice N             CHROMPOLY_NICE         niceness of compute threads
+ *   --sched POLICY       CHROMPOLY_SCHED        other, batch or idle
+ *   --worker-cpus LIST   CHROMPOLY_WORKER_CPUS  e.g. 4-31 or 0,2,4-7
+ *   --ui-cpus LIST       CHROMPOLY_UI_CPUS
+ *
+ * Each thread applies its own placement when it starts, and prints what it
+ * actually got, read back from the kernel, so that refused settings show.
+ * Placement is only supported on Linux.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define PLACEMENT_MAX_CPUS 1024
+
+typedef struct {
+  bool set_nice;
+  int nice;
+  int policy;    // Index in sched_policy_names, or -1 to keep the default
+  bool set_cpus; // Restrict to the CPUs set in cpus
+  bool cpus[PLACEMENT_MAX_CPUS];
+} ThreadPlacement;
+
+typedef struct {
+  int workers; // Threads in the pool, or -1 for the default
+  ThreadPlacement compute;
+  ThreadPlacement ui;
+} PlacementConfig;
+
+const char *sched_policy_names[] = {"other", "batch", "idle"};
+#define SCHED_POLICY_COUNT 3
+
+bool _parse_int(const char *s, int *value) {
+  char *end;
+  errno = 0;
+  long x = strtol(s, &end, 10);
+  if (errno != 0 || end == s || *end != '\0' || x < -1000000 || x > 1000000)
+    return false;
+  *value = x;
+  return true;
+}
+
+/* Parse a CPU list such as "0-3,8" into cpus */
+bool _parse_cpu_list(const char *s, bool *cpus) {
+  memset(cpus, 0, PLACEMENT_MAX_CPUS * sizeof(bool));
+  while (*s != '\0') {
+    char *end;
+    long lo = strtol(s, &end, 10), hi = lo;
+    if (end == s)
+      return false;
+    s = end;
+    if (*s == '-') {
+      hi = strtol(s + 1, &end, 10);
+      if (end == s + 1)
+        return false;
+      s = end;
+    }
+    if (lo < 0 || hi < lo || hi >= PLACEMENT_MAX_CPUS)
+      return false;
+    for (long cpu = lo; cpu <= hi; cpu++)
+      cpus[cpu] = true;
+    if (*s == ',')
+      s++;
+    else if (*s != '\0')
+      return false;
+  }
+  return true;
+}
+
+/* Write cpus as a CPU list into buf, which holds size characters */
+void _format_cpu_list(bool *cpus, char *buf, size_t size) {
+  int len = 0;
+  buf[0] = '\0';
+  for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS && len < size; cpu++) {
+    if (!cpus[cpu])
+      continue;
+    int last = cpu;
+    while (last + 1 < PLACEMENT_MAX_CPUS && cpus[last + 1])
+      last++;
+    len += snprintf(buf + len, size - len, "%s%d", len > 0 ? "," : "", cpu);
+    if (last > cpu && len < size)
+      len += snprintf(buf + len, size - len, "-%d", last);
+    cpu = last;
+  }
+}
+
+/* Apply the setting name = value, where name is an option without its
+leading "--". Returns false, after printing why, if it is invalid. */
+bool _placement_set(PlacementConfig *config, const char *name,
+                    const char *value) {
+  bool ok = true;
+  if (strcmp(name, "workers") == 0) {
+    ok = _parse_int(value, &config->workers) && config->workers >= 0;
+  } else if (strcmp(name, "nice") == 0) {
+    ok = _parse_int(value, &config->compute.nice);
+    config->compute.set_nice = ok;
+  } else if (strcmp(name, "sched") == 0) {
+    config->compute.policy = -1;
+    for (int i = 0; i < SCHED_POLICY_COUNT; i++)
+      if (strcmp(value, sched_policy_names[i]) == 0)
+        config->compute.policy = i;
+    ok = config->compute.policy >= 0;
+  } else if (strcmp(name, "worker-cpus") == 0) {
+    ok = _parse_cpu_list(value, config->compute.cpus);
+    config->compute.set_cpus = ok;
+  } else if (strcmp(name, "ui-cpus") == 0) {
+    ok = _parse_cpu_list(value, config->ui.cpus);
+    config->ui.set_cpus = ok;
+  }
+  if (!ok)
+    printf("Invalid value for %s: %s\n", name, value);
+  return ok;
+}
+
+/* Read the settings given in the environment. Returns false, after printing
+why, if one is invalid. */
+bool placement_from_env(PlacementConfig *config) {
+  memset(config, 0, sizeof(*config));
+  config->workers = -1;
+  config->compute.policy = config->ui.policy = -1;
+  const char *vars[][2] = {{"CHROMPOLY_WORKERS", "workers"},
+                           {"CHROMPOLY_NICE", "nice"},
+                           {"CHROMPOLY_SCHED", "sched"},
+                           {"CHROMPOLY_WORKER_CPUS", "worker-cpus"},
+                           {"CHROMPOLY_UI_CPUS", "ui-cpus"}};
+  for (int i = 0; i < sizeof(vars) / sizeof(vars[0]); i++) {
+    const char *value = getenv(vars[i][0]);
+    if (value != NULL && !_placement_set(config, vars[i][1], value))
+      return false;
+  }
+  return true;
+}
+
+/*
+ * If args[0] is a placement option, apply it with its value args[1] and
+ * return 2, the number of arguments used. Returns 0 if args[0] is not an
+ * option, and -1, after printing why, if it is invalid.
+ */
+int placement_parse_option(PlacementConfig *config, int count, char **args) {
+  const char *options[] = {"--workers", "--nice", "--sched", "--worker-cpus",
+                           "--ui-cpus"};
+  for (int i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+    if (strcmp(args[0], options[i]) != 0)
+      continue;
+    if (count < 2) {
+      printf("Missing value for %s\n", args[0]);
+      return -1;
+    }
+    return _placement_set(config, options[i] + 2, args[1]) ? 2 : -1;
+  }
+  if (strncmp(args[0], "--", 2) == 0) {
+    printf("Unknown option %s\n", args[0]);
+    return -1;
+  }
+  return 0;
+}
+
+bool placement_is_default(ThreadPlacement *p) {
+  return !p->set_nice && p->policy < 0 && !p->set_cpus;
+}
+
+/*
+ * Apply p to the calling thread, and print the placement it ends up with as
+ * "placement: <role>: ...". Settings the system refuses are reported and
+ * left as they were. Does nothing for a default placement.
+ */
+void placement_apply(ThreadPlacement *p, const char *role) {
+  if (placement_is_default(p))
+    return;
+#ifdef __linux__
+  pid_t tid = syscall(SYS_gettid);
+  char errors[256] = "";
+  int len = 0;
+  if (p->set_cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS && cpu < CPU_SETSIZE; cpu++)
+      if (p->cpus[cpu])
+        CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+      len += snprintf(errors + len, sizeof(errors) - len, " (cpus: %s)",
+                      strerror(errno));
+  }
+  if (p->policy >= 0) {
+    int policies[] = {SCHED_OTHER, SCHED_BATCH, SCHED_IDLE};
+    struct sched_param param = {0};
+    if (sched_setscheduler(0, policies[p->policy], &param) != 0 &&
+        len < sizeof(errors))
+      len += snprintf(errors + len, sizeof(errors) - len, " (sched: %s)",
+                      strerror(errno));
+  }
+  // Linux keeps a niceness per thread
+  if (p->set_nice && setpriority(PRIO_PROCESS, tid, p->nice) != 0 &&
+      len < sizeof(errors))
+    len += snprintf(errors + len, sizeof(errors) - len, " (nice: %s)",
+                    strerror(errno));
+
+  // Report what the kernel says, not what was asked for
+  cpu_set_t set;
+  bool cpus[PLACEMENT_MAX_CPUS] = {false};
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS && cpu < CPU_SETSIZE; cpu++)
+      cpus[cpu] = CPU_ISSET(cpu, &set);
+  }
+  char cpu_list[256];
+  _format_cpu_list(cpus, cpu_list, sizeof(cpu_list));
+  int policy = sched_getscheduler(0);
+  const char *policy_name = policy == SCHED_BATCH  ? "batch"
+                            : policy == SCHED_IDLE ? "idle"
+                            : policy == SCHED_OTHER ? "other"
+                                                    : "realtime";
+  errno = 0;
+  int nice = getpriority(PRIO_PROCESS, tid);
+  printf("placement: %s (thread %d): nice %d, sched %s, cpus %s%s\n", role,
+         (int)tid, nice, policy_name, cpu_list, errors);
+#else
+  printf("placement: %s: not supported on this platform\n", role);
+#endif
+}
@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Planarity test, to pick the separator engine for planar graphs, which all
+ * have small separators.
+ *
+ * A graph is planar iff each of its biconnected blocks is. Blocks are tested
+ * with the algorithm of Demoucron, Malgrange and Pertuiset: starting from a
+ * cycle drawn in the plane, repeatedly draw a path of some fragment (a piece
+ * of the graph not yet drawn) across a face that contains all the vertices
+ * where the fragment attaches, choosing a fragment with a single such face
+ * first. The block is planar iff no fragment is ever left without a face.
+ * This is quadratic in the vertices, which is plenty for the graphs the
+ * engine is given.
+ *
+ * Included from chrompoly.c after submap.c, for the Edge type.
+ */
+#include "array.h"
+#include <stdlib.h>
+#include <string.h>
+
+array_def(array_int, face);
+
+typedef struct {
+  int n;
+  bool *adj;      // n x n
+  bool *drawn;    // n x n, edges drawn so far
+  bool *on_plane; // Vertices drawn so far
+  array_face faces;
+} PlaneDrawing;
+
+/* A fragment: an undrawn edge between drawn vertices (component -1) or a
+component of the undrawn vertices, with the drawn vertices it attaches to */
+typedef struct {
+  int component;
+  int u, v; // The edge, if component is -1
+  array_int attachments;
+} Fragment;
+array_def(Fragment, fragment);
+
+/* Does face contain every attachment of fragment? mark is scratch of n. */
+bool _face_admits(array_int *face, Fragment *fragment, bool *mark, int n) {
+  memset(mark, 0, n * sizeof(bool));
+  array_foreach(face, int v) { mark[v] = true; }
+  array_foreach(&fragment->attachments, int v) {
+    if (!mark[v])
+      return false;
+  }
+  return true;
+}
+
+/* Split face f along path, whose first and last vertices lie on it */
+void _draw_path(PlaneDrawing *d, int f, array_int *path) {
+  array_int *face = &array_at(&d->faces, f);
+  int a = array_at(path, 0), b = array_last(path), len = array_size(face);
+  int ia = 0, ib = 0;
+  array_enumerate(face, i, int v) {
+    if (v == a)
+      ia = i;
+    if (v == b)
+      ib = i;
+  }
+  // One face goes from a to b along the old face and back along the path,
+  // the other from b to a and back along the path reversed
+  array_int first, second;
+  array_init(&first);
+  array_init(&second);
+  for (int i = ia; i != ib; i = (i + 1) % len)
+    array_add(&first, array_at(face, i));
+  for (int i = ib; i != ia; i = (i + 1) % len)
+    array_add(&second, array_at(face, i));
+  int inner = array_size(path) - 1;
+  for (int i = inner; i > 0; i--)
+    array_add(&first, array_at(path, i));
+  for (int i = 0; i < inner; i++)
+    array_add(&second, array_at(path, i));
+  array_term(face);
+  *face = first;
+  array_add(&d->faces, second);
+  for (int i = 0; i < array_size(path); i++) {
+    int v = array_at(path, i);
+    d->on_plane[v] = true;
+    if (i > 0) {
+      int u = array_at(path, i - 1);
+      d->drawn[u * d->n + v] = d->drawn[v * d->n + u] = true;
+    }
+  }
+}
+
+/* The fragments of the block with the given vertices, whose components of
+undrawn vertices are numbered in component */
+array_fragment _fragments(PlaneDrawing *d, array_int *vertices,
+                          int *component) {
+  int n = d->n;
+  array_fragment fragments;
+  array_init(&fragments);
+  // attached[v] is the last fragment found to attach to v
+  int *attached = malloc(n * sizeof(int));
+  array_foreach(vertices, int v) { component[v] = attached[v] = -1; }
+  array_int stack;
+  array_init(&stack);
+  array_foreach(vertices, int root) {
+    if (d->on_plane[root] || component[root] >= 0)
+      continue;
+    Fragment fragment = {array_size(&fragments), -1, -1};
+    array_init(&fragment.attachments);
+    component[root] = fragment.component;
+    array_add(&stack, root);
+    while (array_size(&stack) > 0) {
+      int v = array_last(&stack);
+      array_del_last(&stack);
+      array_foreach(vertices, int u) {
+        if (!d->adj[v * n + u])
+          continue;
+        if (d->on_plane[u] && attached[u] != fragment.component) {
+          attached[u] = fragment.component;
+          array_add(&fragment.attachments, u);
+        } else if (!d->on_plane[u] && component[u] < 0) {
+          component[u] = fragment.component;
+          array_add(&stack, u);
+        }
+      }
+    }
+    array_add(&fragments, fragment);
+  }
+  array_term(&stack);
+  free(attached);
+  array_foreach(vertices, int v) {
+    array_foreach(vertices, int u) {
+      if (v < u && d->on_plane[v] && d->on_plane[u] && d->adj[v * n + u] &&
+          !d->drawn[v * n + u]) {
+        Fragment fragment = {-1, v, u};
+        array_init(&fragment.attachments);
+        array_add(&fragment.attachments, v);
+        array_add(&fragment.attachments, u);
+        array_add(&fragments, fragment);
+      }
+    }
+  }
+  return fragments;
+}
+
+/* A path through fragment between two of its attachments */
+array_int _fragment_path(PlaneDrawing *d, Fragment *fragment, int *component,
+                         array_int *vertices) {
+  int n = d->n;
+  array_int path;
+  array_init(&path);
+  if (fragment->component < 0) {
+    array_add(&path, fragment->u);
+    array_add(&path, fragment->v);
+    return path;
+  }
+  // Breadth-first search from a neighbour of attachment a until a vertex
+  // that has another attachment as a neighbour
+  int a = array_at(&fragment->attachments, 0);
+  int *parent = malloc(n * sizeof(int));
+  array_int queue;
+  array_init(&queue);
+  array_foreach(vertices, int v) {
+    parent[v] = -2;
+    if (array_size(&queue) == 0 && component[v] == fragment->component &&
+        d->adj[a * n + v]) {
+      parent[v] = -1;
+      array_add(&queue, v);
+    }
+  }
+  int end = -1, b = -1;
+  for (int head = 0; head < array_size(&queue) && b < 0; head++) {
+    int v = array_at(&queue, head);
+    array_foreach(vertices, int u) {
+      if (!d->adj[v * n + u])
+        continue;
+      if (d->on_plane[u] && u != a) {
+        end = v;
+        b = u;
+        break;
+      }
+      if (component[u] == fragment->component && parent[u] == -2) {
+        parent[u] = v;
+        array_add(&queue, u);
+      }
+    }
+  }
+  // b is a vertex of the block's drawing other than a, as blocks are
+  // biconnected. The path is a, ..., end, b.
+  array_add(&path, b);
+  for (int v = end; v >= 0; v = parent[v])
+    array_add(&path, v);
+  array_add(&path, a);
+  array_term(&queue);
+  free(parent);
+  return path;
+}
+
+/* A cycle of the block with the given vertices, which is biconnected */
+array_int _block_cycle(PlaneDrawing *d, array_int *vertices) {
+  // Follow an edge u-v back to u by a path avoiding that edge
+  int n = d->n, u = array_at(vertices, 0), v = -1;
+  array_foreach(vertices, int w) {
+    if (v < 0 && d->adj[u * n + w])
+      v = w;
+  }
+  int *parent = malloc(n * sizeof(int));
+  array_foreach(vertices, int w) { parent[w] = -2; }
+  array_int queue;
+  array_init(&queue);
+  array_add(&queue, v);
+  parent[v] = -1;
+  for (int head = 0; head < array_size(&queue) && parent[u] == -2; head++) {
+    int w = array_at(&queue, head);
+    array_foreach(vertices, int x) {
+      if (d->adj[w * n + x] && parent[x] == -2 && !(w == v && x == u)) {
+        parent[x] = w;
+        array_add(&queue, x);
+      }
+    }
+  }
+  array_int cycle;
+  array_init(&cycle);
+  for (int w = u; w >= 0; w = parent[w])
+    array_add(&cycle, w);
+  array_term(&queue);
+  free(parent);
+  return cycle;
+}
+
+/* Is the biconnected block with the given vertices and edge_count edges
+planar? */
+bool _block_is_planar(PlaneDrawing *d, array_int *vertices, int edge_count) {
+  int n = array_size(vertices);
+  // Subgraphs of K5 or K3,3 are too small to be nonplanar, and too many
+  // edges cannot be drawn without crossings
+  if (edge_count <= 8)
+    return true;
+  if (edge_count > 3 * n - 6)
+    return false;
+
+  array_foreach(vertices, int v) { d->on_plane[v] = false; }
+  array_init(&d->faces);
+  array_int cycle = _block_cycle(d, vertices);
+  array_int copy;
+  array_init(&copy);
+  array_foreach(&cycle, int v) { array_add(&copy, v); }
+  array_foreach(&cycle, int v) { d->on_plane[v] = true; }
+  for (int i = 0; i < array_size(&cycle); i++) {
+    int u = array_at(&cycle, i);
+    int v = array_at(&cycle, (i + 1) % array_size(&cycle));
+    d->drawn[u * d->n + v] = d->drawn[v * d->n + u] = true;
+  }
+  array_add(&d->faces, cycle);
+  array_add(&d->faces, copy);
+
+  int *component = malloc(d->n * sizeof(int));
+  bool *mark = malloc(d->n * sizeof(bool));
+  bool planar = true;
+  for (int drawn = array_size(&cycle); planar && drawn < edge_count;) {
+    array_fragment fragments = _fragments(d, vertices, component);
+    // The first fragment with the fewest admissible faces, and one of them
+    int best = -1, best_count = 0, best_face = -1;
+    array_enumerate(&fragments, i, Fragment fragment) {
+      int count = 0, face = -1;
+      array_enumerate(&d->faces, f, array_int candidate) {
+        if (_face_admits(&candidate, &fragment, mark, d->n)) {
+          count++;
+          face = f;
+        }
+      }
+      if (best < 0 || count < best_count) {
+        best = i;
+        best_count = count;
+        best_face = face;
+      }
+      if (count <= 1)
+        break;
+    }
+    planar = best_count > 0;
+    if (planar) {
+      array_int path = _fragment_path(d, &array_at(&fragments, best),
+                                      component, vertices);
+      _draw_path(d, best_face, &path);
+      drawn += array_size(&path) - 1;
+      array_term(&path);
+    }
+    array_foreach(&fragments, Fragment fragment) {
+      array_term(&fragment.attachments);
+    }
+    array_term(&fragments);
+  }
+  free(component);
+  free(mark);
+  array_foreach(&d->faces, array_int face) { array_term(&face); }
+  array_term(&d->faces);
+  return planar;
+}
+
+/* Tarjan's biconnected blocks, depth first from v: edges go on the stack and
+are popped as a block when a vertex turns out to be an articulation point */
+typedef struct {
+  int time;
+  int *discovered, *low;
+  int *block; // Last block found to contain each vertex
+  int block_count;
+  array_edge stack;
+  bool planar;
+} BlockSearch;
+
+void _block_search(PlaneDrawing *d, BlockSearch *s, int v, int parent) {
+  int n = d->n;
+  s->discovered[v] = s->low[v] = ++s->time;
+  for (int u = 0; u < n && s->planar; u++) {
+    if (!d->adj[v * n + u] || u == parent)
+      continue;
+    if (s->discovered[u] == 0) {
+      array_add(&s->stack, ((Edge){v, u}));
+      _block_search(d, s, u, v);
+      if (s->low[u] < s->low[v])
+        s->low[v] = s->low[u];
+      if (s->low[u] < s->discovered[v])
+        continue;
+      // v separates the edges above v-u from the rest: they form a block
+      array_int vertices;
+      array_init(&vertices);
+      int edge_count = 0;
+      s->block_count++;
+      Edge edge;
+      do {
+        edge = array_last(&s->stack);
+        array_del_last(&s->stack);
+        edge_count++;
+        int ends[2] = {edge.start_idx, edge.end_idx};
+        for (int i = 0; i < 2; i++) {
+          if (s->block[ends[i]] != s->block_count) {
+            s->block[ends[i]] = s->block_count;
+            array_add(&vertices, ends[i]);
+          }
+        }
+      } while (edge.start_idx != v || edge.end_idx != u);
+      if (s->planar)
+        s->planar = _block_is_planar(d, &vertices, edge_count);
+      array_term(&vertices);
+    } else if (s->discovered[u] < s->discovered[v]) {
+      array_add(&s->stack, ((Edge){v, u}));
+      if (s->discovered[u] < s->low[v])
+        s->low[v] = s->discovered[u];
+    }
+  }
+}
+
+/* Can the graph with n vertices and the given edges be drawn in the plane
+without crossings? */
+bool graph_is_planar(int n, array_edge *edges) {
+  if (n <= 4)
+    return true;
+  PlaneDrawing d = {n};
+  d.adj = calloc(n * n, sizeof(bool));
+  d.drawn = calloc(n * n, sizeof(bool));
+  d.on_plane = calloc(n, sizeof(bool));
+  int m = 0;
+  array_foreach(edges, Edge edge) {
+    int u = edge.start_idx, v = edge.end_idx;
+    if (u == v || d.adj[u * n + v])
+      continue;
+    d.adj[u * n + v] = d.adj[v * n + u] = true;
+    m++;
+  }
+  BlockSearch s = {0};
+  s.discovered = calloc(n, sizeof(int));
+  s.low = calloc(n, sizeof(int));
+  s.block = calloc(n, sizeof(int));
+  array_init(&s.stack);
+  s.planar = m <= 3 * n - 6;
+  for (int v = 0; v < n && s.planar; v++) {
+    if (s.discovered[v] == 0)
+      _block_search(&d, &s, v, -1);
+  }
+  array_term(&s.stack);
+  free(s.discovered);
+  free(s.low);
+  free(s.block);
+  free(d.adj);
+  free(d.drawn);
+  free(d.on_plane);
+  return s.planar;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Polynomial arithmetic for the engines that combine the polynomials of parts
+ * of a graph: the separator sweep and deletion-contraction. Both keep
+ * polynomials as arrays of uint64_t coefficients, P[i] for x^i, computed
+ * modulo 2^64. The arithmetic wraps around, which is exact for every result
+ * whose coefficients fit, however large the intermediate values get, and
+ * poly_is_exact() tells from bounds on the coefficients whether they do.
+ *
+ * Products of long polynomials use Karatsuba's method. Degrees are bounded by
+ * the number of vertices, a few hundred at most, well below the degrees
+ * where an NTT would pay off.
+ *
+ * There are only word-size coefficients. Carrying big integers through the
+ * memo table of delcon and the frontier table of the sweep would multiply
+ * their memory and time for every graph, to serve only those whose
+ * polynomial is refused as too large. The engines need no divisions, shifts
+ * or falling-factorial bases either, so there are none.
+ *
+ * Included from chrompoly.c before separator.c and delcon.c, which use it.
+ */
+#include "array.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POLY_KARATSUBA_MIN 32 // Shorter products are done term by term
+
+/* Multiply P, of the given degree, by x - k. P must have room for
+degree + 2 coefficients. */
+void poly_mul_linear(uint64_t *P, int degree, uint64_t k) {
+  P[degree + 1] = P[degree];
+  for (int i = degree; i > 0; i--)
+    P[i] = P[i - 1] - k * P[i];
+  P[0] *= -k;
+}
+
+/* Add (x - k) Q to P, both of length coefficients, dropping the term of
+x^length */
+void poly_add_mul_linear(uint64_t *P, const uint64_t *Q, int length,
+                         uint64_t k) {
+  for (int i = length - 1; i >= 0; i--)
+    P[i] += (i > 0 ? Q[i - 1] : 0) - k * Q[i];
+}
+
+/* out[0, 2n) = a[0, n) * b[0, n), term by term */
+void _poly_mul_schoolbook(const uint64_t *a, const uint64_t *b, int n,
+                          uint64_t *out) {
+  memset(out, 0, 2 * n * sizeof(uint64_t));
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++)
+      out[i + j] += a[i] * b[j];
+  }
+}
+
+/*
+ * out[0, 2n) = a[0, n) * b[0, n), splitting each factor into a low half of h
+ * terms and a high half of m = n - h, so that three products of m terms
+ * replace four.
+ */
+void _poly_mul_karatsuba(const uint64_t *a, const uint64_t *b, int n,
+                         uint64_t *out) {
+  if (n < POLY_KARATSUBA_MIN) {
+    _poly_mul_schoolbook(a, b, n, out);
+    return;
+  }
+  int h = n / 2, m = n - h;
+  uint64_t *sums = malloc(4 * m * sizeof(uint64_t));
+  uint64_t *sa = sums, *sb = sums + m, *mid = sums + 2 * m;
+  for (int i = 0; i < m; i++) {
+    sa[i] = a[h + i] + (i < h ? a[i] : 0);
+    sb[i] = b[h + i] + (i < h ? b[i] : 0);
+  }
+  _poly_mul_karatsuba(a, b, h, out);                 // Low halves: [0, 2h)
+  _poly_mul_karatsuba(a + h, b + h, m, out + 2 * h); // High halves: [2h, 2n)
+  _poly_mul_karatsuba(sa, sb, m, mid);
+  for (int i = 0; i < 2 * m; i++) {
+    mid[i] -= out[2 * h + i];
+    if (i < 2 * h)
+      mid[i] -= out[i];
+  }
+  for (int i = 0; i < 2 * m; i++)
+    out[h + i] += mid[i];
+  free(sums);
+}
+
+/* Add A * B, of degrees a and b, to P, which must have room for a + b + 1
+coefficients */
+void poly_add_product(uint64_t *P, const uint64_t *A, int a, const uint64_t *B,
+                      int b) {
+  if (a + 1 < POLY_KARATSUBA_MIN || b + 1 < POLY_KARATSUBA_MIN) {
+    // Factors of chromatic polynomials often have zero low terms
+    for (int i = 0; i <= a; i++) {
+      if (A[i] != 0) {
+        for (int j = 0; j <= b; j++)
+          P[i + j] += A[i] * B[j];
+      }
+    }
+    return;
+  }
+  // Karatsuba on factors padded to the same length
+  int n = (a > b ? a : b) + 1;
+  uint64_t *buffer = calloc(4 * n, sizeof(uint64_t));
+  uint64_t *pa = buffer, *pb = buffer + n, *product = buffer + 2 * n;
+  memcpy(pa, A, (a + 1) * sizeof(uint64_t));
+  memcpy(pb, B, (b + 1) * sizeof(uint64_t));
+  _poly_mul_karatsuba(pa, pb, n, product);
+  for (int i = 0; i <= a + b; i++)
+    P[i] += product[i];
+  free(buffer);
+}
+
+/* min(a * b, UINT64_MAX) */
+uint64_t _mul_saturate(uint64_t a, uint64_t b) {
+  unsigned __int128 product = (unsigned __int128)a * b;
+  return product > UINT64_MAX ? UINT64_MAX : (uint64_t)product;
+}
+
+/* min(a + b, UINT64_MAX) */
+uint64_t _add_saturate(uint64_t a, uint64_t b) {
+  return a + b < a ? UINT64_MAX : a + b;
+}
+
+/*
+ * Whether P, the chromatic polynomial of a graph with n = array_size(P)
+ * vertices and m edges as the engines leave it (P[i] for x^(i + 1), each
+ * computed modulo 2^64), holds the true coefficients.
+ *
+ * The coefficient of x^(n - j) has the sign (-1)^j, and its absolute value
+ * counts sets of j edges without a broken circuit (Whitney), so it is at most
+ * C(m, j). Adding an edge never makes it smaller, so it is also at most that
+ * of the complete graph, the unsigned Stirling number |s(n, n - j)|. Below
+ * 2^64, the bound leaves a single candidate for the residue, which must then
+ * also fit in a long long.
+ */
+bool poly_is_exact(array_ll *P, int m) {
+  int n = array_size(P);
+  if (n == 0)
+    return true;
+  // Row n of the unsigned Stirling numbers of the first kind, by
+  // |s(i, k)| = |s(i - 1, k - 1)| + (i - 1) |s(i - 1, k)|
+  uint64_t *stirling = calloc(n + 1, sizeof(uint64_t));
+  stirling[0] = 1;
+  for (int i = 1; i <= n; i++) {
+    for (int k = i; k >= 1; k--)
+      stirling[k] =
+          _add_saturate(stirling[k - 1], _mul_saturate(i - 1, stirling[k]));
+    stirling[0] = 0;
+  }
+  // C(m, k) up to the middle of the row, where it stops growing, so that
+  // saturating is safe
+  int half = m / 2 < n ? m / 2 : n - 1;
+  uint64_t *binomial = malloc((half + 1) * sizeof(uint64_t));
+  binomial[0] = 1;
+  for (int k = 1; k <= half; k++) {
+    unsigned __int128 next =
+        (unsigned __int128)binomial[k - 1] * (m - k + 1) / k;
+    binomial[k] = binomial[k - 1] == UINT64_MAX || next > UINT64_MAX
+                      ? UINT64_MAX
+                      : (uint64_t)next;
+  }
+  bool exact = true;
+  for (int j = 0; j < n && exact; j++) {
+    uint64_t bound = 0;
+    if (j <= m) {
+      uint64_t b = binomial[j < m - j ? j : m - j];
+      bound = b < stirling[n - j] ? b : stirling[n - j];
+    }
+    uint64_t residue = array_at(P, n - j - 1);
+    uint64_t magnitude = j % 2 == 0 ? residue : -residue;
+    exact = bound < UINT64_MAX && magnitude <= bound && magnitude <= INT64_MAX;
+  }
+  free(binomial);
+  free(stirling);
+  return exact;
+}
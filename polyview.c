@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * The chromatic polynomial as shown in the overlay, such as
+ * "x⁴-4x³+6x²-3x".
+ * Polynomials of large graphs have thousands of terms, far more than fit on a
+ * line, so the view only formats the terms it has room for, starting at a
+ * term the user scrolls to. It shows them on one line, or wrapped over a few
+ * rows, with "…" where terms are hidden. Coefficients with many digits can be
+ * abbreviated to three significant digits, as in "1.23×10⁹".
+ */
+#include "array.h"
+#include "raylib/raylib.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ABBREVIATE_DIGITS 6  // Coefficients with more digits are abbreviated
+#define ABBREVIATED_DIGITS 3 // Significant digits kept when abbreviating
+#define ELLIPSIS 0x2026
+#define TIMES 0xd7
+
+typedef struct {
+  array_int powers; // Powers of x with a nonzero coefficient, highest first
+  int first_term;   // Index in powers of the first term shown
+  bool wrap;        // Show terms over several rows instead of one
+  bool abbreviate;
+  array_int row; // Codepoints of the row being laid out
+  array_int term;
+} PolyView;
+
+int get_superscript_codepoint(int digit) {
+  if (digit == 0)
+    return 0x2070;
+  else if (digit == 1)
+    return 0xb9;
+  else if (digit == 2 || digit == 3)
+    return 0xb2 + (digit - 2);
+  else
+    return 0x2074 + (digit - 4);
+}
+
+void polyview_init(PolyView *view) {
+  array_init(&view->powers);
+  array_init(&view->row);
+  array_init(&view->term);
+  view->first_term = 0;
+  view->wrap = false;
+  view->abbreviate = true;
+}
+
+void polyview_term(PolyView *view) {
+  array_term(&view->powers);
+  array_term(&view->row);
+  array_term(&view->term);
+}
+
+/* Show P, from its leading term */
+void polyview_reset(PolyView *view, array_ll *P) {
+  array_clear(&view->powers);
+  for (int power = array_size(P); power >= 1; power--) {
+    if (array_at(P, power - 1) != 0)
+      array_add(&view->powers, power);
+  }
+  view->first_term = 0;
+}
+
+/* Move the first term shown by terms, which may be negative */
+void polyview_scroll(PolyView *view, int terms) {
+  int last = (int)array_size(&view->powers) - 1;
+  view->first_term += terms;
+  if (view->first_term > last)
+    view->first_term = last;
+  if (view->first_term < 0)
+    view->first_term = 0;
+}
+
+void _add_ascii(array_int *codepoints, const char *s) {
+  for (; *s != '\0'; s++)
+    array_add(codepoints, *s);
+}
+
+void _add_superscript(array_int *codepoints, int n) {
+  char digits[16];
+  snprintf(digits, sizeof(digits), "%d", n);
+  for (char *d = digits; *d != '\0'; d++)
+    array_add(codepoints, get_superscript_codepoint(*d - '0'));
+}
+
+/* Add the absolute value of a coefficient, given by its decimal digits */
+void _add_coefficient(PolyView *view, array_int *codepoints,
+                      const char *digits) {
+  int len = strlen(digits);
+  if (!view->abbreviate || len <= ABBREVIATE_DIGITS) {
+    _add_ascii(codepoints, digits);
+    return;
+  }
+  // Round to ABBREVIATED_DIGITS significant digits, which may carry into an
+  // extra digit, as 9995 does into 1.00×10⁴
+  int exponent = len - 1;
+  int mantissa = 0;
+  for (int i = 0; i <= ABBREVIATED_DIGITS; i++)
+    mantissa = 10 * mantissa + (digits[i] - '0');
+  mantissa = (mantissa + 5) / 10;
+  int limit = 1;
+  for (int i = 0; i < ABBREVIATED_DIGITS; i++)
+    limit *= 10;
+  if (mantissa == limit) {
+    mantissa /= 10;
+    exponent++;
+  }
+  char text[16];
+  snprintf(text, sizeof(text), "%d", mantissa);
+  // Trailing zeros after the point are dropped: 1.20 becomes 1.2, 1.00 is 1
+  int kept = ABBREVIATED_DIGITS;
+  while (kept > 1 && text[kept - 1] == '0')
+    kept--;
+  array_add(codepoints, text[0]);
+  if (kept > 1) {
+    array_add(codepoints, '.');
+    for (int i = 1; i < kept; i++)
+      array_add(codepoints, text[i]);
+  }
+  array_add(codepoints, TIMES);
+  _add_ascii(codepoints, "10");
+  _add_superscript(codepoints, exponent);
+}
+
+/* Add the codepoints of the term at index in view->powers, with its sign */
+void _format_term(PolyView *view, array_ll *P, int index,
+                  array_int *codepoints) {
+  int power = array_at(&view->powers, index);
+  long long coeff = array_at(P, power - 1);
+  if (coeff < 0)
+    array_add(codepoints, '-');
+  else if (index > 0)
+    array_add(codepoints, '+');
+  if (coeff != 1 && coeff != -1) {
+    char digits[32];
+    snprintf(digits, sizeof(digits), "%lld", coeff < 0 ? -coeff : coeff);
+    _add_coefficient(view, codepoints, digits);
+  }
+  array_add(codepoints, 'x');
+  if (power > 1)
+    _add_superscript(codepoints, power);
+}
+
+/* Width of codepoints as DrawTextCodepoints() lays them out */
+float _codepoints_width(Font font, array_int *codepoints, float size,
+                        float spacing) {
+  float scale = size / font.baseSize;
+  float width = 0;
+  array_foreach(codepoints, int codepoint) {
+    int glyph = GetGlyphIndex(font, codepoint);
+    float advance = font.glyphs[glyph].advanceX != 0
+                        ? font.glyphs[glyph].advanceX
+                        : font.recs[glyph].width;
+    width += advance * scale + spacing;
+  }
+  return width;
+}
+
+/*
+ * Draw P, which must be the polynomial last given to polyview_reset(), in the
+ * area of the given width starting at position: on rows rows of row_height if
+ * wrapping, and on one row otherwise. Only the terms that fit are formatted.
+ */
+void polyview_draw(PolyView *view, array_ll *P, Font font, Vector2 position,
+                   float width, int rows, float row_height, float size,
+                   Color color) {
+  int count = array_size(&view->powers);
+  if (!view->wrap)
+    rows = 1;
+  array_clear(&view->term);
+  array_add(&view->term, ELLIPSIS);
+  float ellipsis_width = _codepoints_width(font, &view->term, size, 0);
+
+  int index = view->first_term;
+  for (int r = 0; r < rows && index < count; r++) {
+    array_clear(&view->row);
+    if (r == 0 && index > 0)
+      array_add(&view->row, ELLIPSIS);
+    float x = _codepoints_width(font, &view->row, size, 0);
+    bool row_empty = true;
+    while (index < count) {
+      array_clear(&view->term);
+      _format_term(view, P, index, &view->term);
+      float term_width = _codepoints_width(font, &view->term, size, 0);
+      // Leave room for the ellipsis, unless this is the last term
+      float reserve = index + 1 < count ? ellipsis_width : 0;
+      if (!row_empty && x + term_width + reserve > width)
+        break;
+      array_foreach(&view->term, int codepoint) {
+        array_add(&view->row, codepoint);
+      }
+      x += term_width;
+      row_empty = false;
+      index++;
+    }
+    if (r == rows - 1 && index < count)
+      array_add(&view->row, ELLIPSIS);
+    DrawTextCodepoints(font, view->row.elems, array_size(&view->row),
+                       (Vector2){position.x, position.y + r * row_height},
+                       size, 0.0, color);
+  }
+}
+
+#ifndef NDEBUG
+/* Whether the term of x^power in P, which must have every power, formats as
+the UTF-8 text expected */
+bool _term_is(PolyView *view, array_ll *P, int power, const char *expected) {
+  array_clear(&view->term);
+  _format_term(view, P, array_size(P) - power, &view->term);
+  int count;
+  int *codepoints = LoadCodepoints(expected, &count);
+  bool same = count == array_size(&view->term) &&
+              memcmp(codepoints, view->term.elems, count * sizeof(int)) == 0;
+  UnloadCodepoints(codepoints);
+  return same;
+}
+
+/* Check the terms formatted for P(K_20), whose coefficients reach
+-668609730341153280, and for the largest coefficients poly_is_exact() lets
+through. Run at startup unless NDEBUG is defined. */
+void polyview_self_check() {
+  uint64_t c[21] = {0, 1}; // x(x - 1)...(x - 19), c[i] for x^i
+  for (int k = 1; k < 20; k++)
+    poly_mul_linear(c, k, k);
+  array_ll P;
+  array_init(&P);
+  for (int i = 1; i <= 20; i++)
+    array_add(&P, (long long)c[i]);
+  assert(poly_is_exact(&P, 20 * 19 / 2));
+  PolyView view;
+  polyview_init(&view);
+  polyview_reset(&view, &P);
+  assert(_term_is(&view, &P, 20, "x²⁰"));
+  assert(_term_is(&view, &P, 18, "+16815x¹⁸"));
+  assert(_term_is(&view, &P, 3, "-6.69×10¹⁷x³"));
+  view.abbreviate = false;
+  assert(_term_is(&view, &P, 3, "-668609730341153280x³"));
+  view.abbreviate = true;
+  array_at(&P, 2) = INT64_MAX;
+  array_at(&P, 1) = -INT64_MAX;
+  array_at(&P, 0) = 9995000; // Rounds up to the next power of ten
+  assert(_term_is(&view, &P, 3, "+9.22×10¹⁸x³"));
+  assert(_term_is(&view, &P, 2, "-9.22×10¹⁸x²"));
+  assert(_term_is(&view, &P, 1, "+1×10⁷x"));
+  polyview_term(&view);
+  array_term(&P);
+}
+#endif
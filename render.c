@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Batched rendering of the canvas.
+ * Drawing every node and edge with its own DrawCircle/DrawLineEx call costs a
+ * few thousand vertices per frame on the CPU, which collapses the frame rate
+ * on large graphs. Instead, the geometry of all edges and of all settled
+ * nodes lives in two dynamic meshes drawn with one call each. Every frame the
+ * renderer compares the canvas with what the meshes hold and re-uploads only
+ * the range of vertices that changed, so a still graph costs nothing but the
+ * draw calls, and dragging a node uploads just its vertices and the edges
+ * around it.
+ * Nodes that are animating or selected as the drag target change every frame,
+ * so the caller draws those immediately, on top of the batch.
+ * For far zoom levels there is a cheaper variant of both meshes: nodes as
+ * small squares, and edges merged by the pair of grid cells they join.
+ *
+ * Included from chrompoly.c after canvas.c, for Canvas.
+ */
+#include "array.h"
+#include "raylib/raylib.h"
+#include <math.h>
+
+// Only raylib.h is vendored: declare the few rlgl functions needed here
+void rlDrawRenderBatchActive(void);
+void rlDisableBackfaceCulling(void);
+void rlEnableBackfaceCulling(void);
+
+#define NODE_SEGMENTS 24
+#define NODE_VERTICES (3 * NODE_SEGMENTS) // Triangle fan as separate triangles
+#define EDGE_VERTICES 6                   // Quad as two triangles
+#define POINT_VERTICES 6                  // Quad as two triangles
+#define AGGREGATE_CELL_PIXELS 16 // Size on screen of the cells merging edges
+
+/* What the node mesh holds for a slot */
+typedef struct {
+  bool visible;
+  float x;
+  float y;
+  Color color;
+} BatchedNode;
+array_def(BatchedNode, batched_node);
+
+/* A dynamic mesh whose CPU copy has a range of vertices not yet uploaded */
+typedef struct {
+  Mesh mesh;
+  int capacity;  // Vertices allocated, on the CPU and the GPU
+  int dirty_lo;  // Vertices [dirty_lo, dirty_hi) changed since the last upload
+  int dirty_hi;
+} VertexBatch;
+
+typedef struct {
+  float node_radius;
+  float edge_thickness;
+  Color edge_color;
+  Material material;
+  float unit_circle[NODE_SEGMENTS + 1][2];
+
+  VertexBatch nodes;  // NODE_VERTICES per slot
+  VertexBatch points; // POINT_VERTICES per slot
+  VertexBatch edges;  // EDGE_VERTICES per edge, in the order of canvas->edges
+  array_batched_node drawn_nodes; // Indexed by slot
+  array_canvas_edge drawn_edges;
+  array_bool moved; // Indexed by slot: did the node move this frame?
+  int edge_count;
+  bool synced;
+  unsigned long synced_revision;
+  int synced_skip_slot;
+
+  VertexBatch aggregate; // EDGE_VERTICES per merged edge
+  int aggregate_count;
+  bool aggregated;
+  unsigned long aggregate_revision;
+  float aggregate_zoom;
+} CanvasRenderer;
+
+void renderer_init(CanvasRenderer *r, float node_radius, float edge_thickness,
+                   Color edge_color) {
+  memset(r, 0, sizeof(*r));
+  r->node_radius = node_radius;
+  r->edge_thickness = edge_thickness;
+  r->edge_color = edge_color;
+  r->material = LoadMaterialDefault();
+  for (int i = 0; i <= NODE_SEGMENTS; i++) {
+    r->unit_circle[i][0] = cosf(2 * PI * i / NODE_SEGMENTS);
+    r->unit_circle[i][1] = sinf(2 * PI * i / NODE_SEGMENTS);
+  }
+}
+
+void _batch_term(VertexBatch *batch) {
+  if (batch->capacity > 0)
+    UnloadMesh(batch->mesh);
+  memset(batch, 0, sizeof(*batch));
+}
+
+void renderer_term(CanvasRenderer *r) {
+  _batch_term(&r->nodes);
+  _batch_term(&r->points);
+  _batch_term(&r->edges);
+  _batch_term(&r->aggregate);
+  UnloadMaterial(r->material);
+  array_term(&r->drawn_nodes);
+  array_term(&r->drawn_edges);
+  array_term(&r->moved);
+}
+
+/* Grow batch to hold at least count vertices. The whole mesh is uploaded
+again when it grows, so nothing stays dirty. */
+void _batch_reserve(VertexBatch *batch, int count) {
+  if (count <= batch->capacity)
+    return;
+  int capacity = batch->capacity > 0 ? batch->capacity : 4096;
+  while (capacity < count)
+    capacity *= 2;
+  float *vertices = calloc(3 * capacity, sizeof(float));
+  unsigned char *colors = calloc(4 * capacity, sizeof(unsigned char));
+  if (batch->capacity > 0) {
+    memcpy(vertices, batch->mesh.vertices, 3 * batch->capacity * sizeof(float));
+    memcpy(colors, batch->mesh.colors, 4 * batch->capacity);
+    UnloadMesh(batch->mesh);
+  }
+  batch->mesh = (Mesh){0};
+  batch->mesh.vertices = vertices;
+  batch->mesh.colors = colors;
+  batch->mesh.vertexCount = capacity;
+  batch->mesh.triangleCount = capacity / 3;
+  UploadMesh(&batch->mesh, true);
+  batch->capacity = capacity;
+  batch->dirty_lo = batch->dirty_hi = 0;
+}
+
+void _batch_mark(VertexBatch *batch, int lo, int hi) {
+  if (batch->dirty_lo == batch->dirty_hi) {
+    batch->dirty_lo = lo;
+    batch->dirty_hi = hi;
+    return;
+  }
+  if (lo < batch->dirty_lo)
+    batch->dirty_lo = lo;
+  if (hi > batch->dirty_hi)
+    batch->dirty_hi = hi;
+}
+
+void _batch_set_vertex(VertexBatch *batch, int i, float x, float y,
+                       Color color) {
+  float *v = batch->mesh.vertices + 3 * i;
+  v[0] = x;
+  v[1] = y;
+  v[2] = 0;
+  unsigned char *c = batch->mesh.colors + 4 * i;
+  c[0] = color.r;
+  c[1] = color.g;
+  c[2] = color.b;
+  c[3] = color.a;
+}
+
+void _batch_upload(VertexBatch *batch) {
+  int lo = batch->dirty_lo, count = batch->dirty_hi - batch->dirty_lo;
+  if (count <= 0)
+    return;
+  UpdateMeshBuffer(batch->mesh, 0, batch->mesh.vertices + 3 * lo,
+                   3 * count * sizeof(float), 3 * lo * sizeof(float));
+  UpdateMeshBuffer(batch->mesh, 3, batch->mesh.colors + 4 * lo, 4 * count,
+                   4 * lo);
+  batch->dirty_lo = batch->dirty_hi = 0;
+}
+
+void _write_node(CanvasRenderer *r, int slot, BatchedNode node) {
+  VertexBatch *batch = &r->nodes;
+  int base = slot * NODE_VERTICES;
+  for (int i = 0; i < NODE_SEGMENTS; i++) {
+    // A hidden node collapses to a point, which rasterizes to nothing
+    float radius = node.visible ? r->node_radius : 0;
+    _batch_set_vertex(batch, base + 3 * i, node.x, node.y, node.color);
+    _batch_set_vertex(batch, base + 3 * i + 1,
+                      node.x + radius * r->unit_circle[i][0],
+                      node.y + radius * r->unit_circle[i][1], node.color);
+    _batch_set_vertex(batch, base + 3 * i + 2,
+                      node.x + radius * r->unit_circle[i + 1][0],
+                      node.y + radius * r->unit_circle[i + 1][1], node.color);
+  }
+  _batch_mark(batch, base, base + NODE_VERTICES);
+
+  // The same node as a point, a square covering the circle
+  float radius = node.visible ? r->node_radius : 0;
+  float corners[4][2] = {{node.x - radius, node.y - radius},
+                         {node.x + radius, node.y - radius},
+                         {node.x + radius, node.y + radius},
+                         {node.x - radius, node.y + radius}};
+  const int order[POINT_VERTICES] = {0, 1, 2, 0, 2, 3};
+  base = slot * POINT_VERTICES;
+  for (int k = 0; k < POINT_VERTICES; k++)
+    _batch_set_vertex(&r->points, base + k, corners[order[k]][0],
+                      corners[order[k]][1], node.color);
+  _batch_mark(&r->points, base, base + POINT_VERTICES);
+}
+
+/* Write the i-th quad of batch, a line of the given thickness from (x0, y0)
+to (x1, y1) */
+void _write_line(VertexBatch *batch, int i, float x0, float y0, float x1,
+                 float y1, float thickness, Color color) {
+  float dx = x1 - x0, dy = y1 - y0;
+  float length = sqrtf(dx * dx + dy * dy);
+  // Offset from the center line to either side of the quad
+  float ox = 0, oy = 0;
+  if (length > 0) {
+    ox = -dy / length * thickness / 2;
+    oy = dx / length * thickness / 2;
+  }
+  float corners[4][2] = {{x0 + ox, y0 + oy},
+                         {x0 - ox, y0 - oy},
+                         {x1 - ox, y1 - oy},
+                         {x1 + ox, y1 + oy}};
+  const int order[EDGE_VERTICES] = {0, 1, 2, 0, 2, 3};
+  int base = i * EDGE_VERTICES;
+  for (int k = 0; k < EDGE_VERTICES; k++)
+    _batch_set_vertex(batch, base + k, corners[order[k]][0],
+                      corners[order[k]][1], color);
+  _batch_mark(batch, base, base + EDGE_VERTICES);
+}
+
+void _write_edge(CanvasRenderer *r, int i, Node *start, Node *end) {
+  _write_line(&r->edges, i, start->x, start->y, end->x, end->y,
+              r->edge_thickness, r->edge_color);
+}
+
+/*
+ * Bring the meshes up to date with canvas. node_color gives the color of each
+ * node that belongs in the batch, and returns false for nodes the caller
+ * draws itself, as is the node in skip_slot.
+ * Nothing is compared if the canvas has not changed since the last call.
+ */
+void renderer_sync(CanvasRenderer *r, Canvas *canvas, int skip_slot,
+                   bool (*node_color)(Node *, Color *)) {
+  if (r->synced && r->synced_revision == canvas->revision &&
+      r->synced_skip_slot == skip_slot)
+    return;
+  r->synced = true;
+  r->synced_revision = canvas->revision;
+  r->synced_skip_slot = skip_slot;
+
+  int slot_count = canvas_slot_count(canvas);
+  _batch_reserve(&r->nodes, slot_count * NODE_VERTICES);
+  _batch_reserve(&r->points, slot_count * POINT_VERTICES);
+  while (array_size(&r->drawn_nodes) < slot_count) {
+    array_add(&r->drawn_nodes, ((BatchedNode){0}));
+    array_add(&r->moved, false);
+  }
+
+  for (int slot = 0; slot < slot_count; slot++) {
+    Node node = array_at(&canvas->nodes, slot);
+    BatchedNode want = {.x = node.x, .y = node.y};
+    want.visible = canvas_slot_occupied(canvas, slot) && slot != skip_slot &&
+                   node_color(&node, &want.color);
+    BatchedNode *have = &array_at(&r->drawn_nodes, slot);
+    array_at(&r->moved, slot) = have->x != want.x || have->y != want.y;
+    if (have->visible != want.visible || array_at(&r->moved, slot) ||
+        (want.visible && memcmp(&have->color, &want.color, sizeof(Color)))) {
+      *have = want;
+      _write_node(r, slot, want);
+    }
+  }
+
+  // Edges are drawn in the order of canvas->edges. An edge is rewritten if a
+  // different edge now sits at its index, or if one of its endpoints moved.
+  int edge_count = array_size(&canvas->edges);
+  _batch_reserve(&r->edges, edge_count * EDGE_VERTICES);
+  array_enumerate(&canvas->edges, i, CanvasEdge edge) {
+    bool changed = i >= array_size(&r->drawn_edges);
+    if (changed) {
+      array_add(&r->drawn_edges, edge);
+    } else {
+      CanvasEdge old = array_at(&r->drawn_edges, i);
+      changed = !node_id_eq(old.start, edge.start) ||
+                !node_id_eq(old.end, edge.end) ||
+                array_at(&r->moved, edge.start.slot) ||
+                array_at(&r->moved, edge.end.slot);
+      array_at(&r->drawn_edges, i) = edge;
+    }
+    if (changed)
+      _write_edge(r, i, canvas_node(canvas, edge.start),
+                  canvas_node(canvas, edge.end));
+  }
+  // Edges past the end are simply not drawn
+  r->drawn_edges.size = edge_count;
+  r->edge_count = edge_count;
+
+  _batch_upload(&r->nodes);
+  _batch_upload(&r->points);
+  _batch_upload(&r->edges);
+}
+
+/* A pair of grid cells joined by at least one edge, cells packed as
+(cx << 32 | cy) with a <= b */
+typedef struct {
+  long long a;
+  long long b;
+} CellPair;
+array_def(CellPair, cell_pair);
+
+int cmp_cell_pair(const void *x, const void *y) {
+  CellPair p = *(CellPair *)x, q = *(CellPair *)y;
+  if (p.a != q.a)
+    return (p.a > q.a) - (p.a < q.a);
+  return (p.b > q.b) - (p.b < q.b);
+}
+
+long long _pack_cell(float x, float y, float cell_size) {
+  int cx = floorf(x / cell_size), cy = floorf(y / cell_size);
+  return (long long)cx << 32 | (unsigned int)cy;
+}
+
+/*
+ * Rebuild the merged edges for zoom level zoom, if the canvas or the zoom
+ * changed since they were last built. All edges between the same two cells
+ * become one line between the cell centers, thicker and more opaque the more
+ * edges it stands for. Edges within a single cell are not drawn at all.
+ */
+void _aggregate_edges(CanvasRenderer *r, Canvas *canvas, float zoom) {
+  if (r->aggregated && r->aggregate_revision == canvas->revision &&
+      r->aggregate_zoom == zoom)
+    return;
+  r->aggregated = true;
+  r->aggregate_revision = canvas->revision;
+  r->aggregate_zoom = zoom;
+
+  float cell_size = AGGREGATE_CELL_PIXELS / zoom;
+  array_cell_pair pairs;
+  array_init(&pairs);
+  array_foreach(&canvas->edges, CanvasEdge edge) {
+    Node *start = canvas_node(canvas, edge.start);
+    Node *end = canvas_node(canvas, edge.end);
+    long long a = _pack_cell(start->x, start->y, cell_size);
+    long long b = _pack_cell(end->x, end->y, cell_size);
+    if (a != b)
+      array_add(&pairs, ((CellPair){a < b ? a : b, a < b ? b : a}));
+  }
+  array_sort(&pairs, cmp_cell_pair);
+
+  r->aggregate_count = 0;
+  int runs = 0;
+  for (int i = 0; i < array_size(&pairs); i++)
+    runs += i == 0 || cmp_cell_pair(&array_at(&pairs, i - 1),
+                                    &array_at(&pairs, i)) != 0;
+  _batch_reserve(&r->aggregate, runs * EDGE_VERTICES);
+  for (int i = 0; i < array_size(&pairs);) {
+    int j = i;
+    while (j < array_size(&pairs) &&
+           cmp_cell_pair(&array_at(&pairs, i), &array_at(&pairs, j)) == 0)
+      j++;
+    CellPair pair = array_at(&pairs, i);
+    float strength = log2f(j - i) + 1;
+    Color color = r->edge_color;
+    color.a = fminf(255, 60 + 40 * strength);
+    _write_line(&r->aggregate, r->aggregate_count++,
+                ((int)(pair.a >> 32) + 0.5) * cell_size,
+                ((int)pair.a + 0.5) * cell_size,
+                ((int)(pair.b >> 32) + 0.5) * cell_size,
+                ((int)pair.b + 0.5) * cell_size, strength / zoom, color);
+    i = j;
+  }
+  _batch_upload(&r->aggregate);
+  array_term(&pairs);
+}
+
+void _batch_draw(CanvasRenderer *r, VertexBatch *batch, int count) {
+  if (count == 0)
+    return;
+  Mesh mesh = batch->mesh;
+  mesh.vertexCount = count;
+  mesh.triangleCount = count / 3;
+  DrawMesh(mesh, r->material, (Matrix){.m0 = 1, .m5 = 1, .m10 = 1, .m15 = 1});
+}
+
+/* Draw the edges of canvas, merged if points is set. Must be called after
+renderer_sync(), inside the 2D mode of a camera with the given zoom. */
+void renderer_draw_edges(CanvasRenderer *r, Canvas *canvas, bool points,
+                         float zoom) {
+  if (points)
+    _aggregate_edges(r, canvas, zoom);
+  // Flush what was drawn immediately so far, to keep the draw order
+  rlDrawRenderBatchActive();
+  rlDisableBackfaceCulling();
+  if (points)
+    _batch_draw(r, &r->aggregate, r->aggregate_count * EDGE_VERTICES);
+  else
+    _batch_draw(r, &r->edges, r->edge_count * EDGE_VERTICES);
+  rlEnableBackfaceCulling();
+}
+
+/* Draw the batched nodes, as points if points is set */
+void renderer_draw_nodes(CanvasRenderer *r, bool points) {
+  rlDrawRenderBatchActive();
+  rlDisableBackfaceCulling();
+  if (points)
+    _batch_draw(r, &r->points, array_size(&r->drawn_nodes) * POINT_VERTICES);
+  else
+    _batch_draw(r, &r->nodes, array_size(&r->drawn_nodes) * NODE_VERTICES);
+  rlEnableBackfaceCulling();
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Canvas files: the drawn graph and its chromatic polynomial in a compact
+ * binary format, which is memory-mapped to load, so that even a canvas of
+ * 100k nodes reopens in milliseconds.
+ *
+ * A file holds a header, a table of sections, and the data of the sections,
+ * in the byte order of the machine that wrote it (which the header records):
+ * - nodes: x, y of each vertex as int32 pairs,
+ * - edges: the two vertices of each edge as int32 pairs,
+ * - polynomial, if it was computed: int64 coefficients, of x first.
+ * Readers skip the sections they do not know, which leaves room for engine
+ * artefacts. The header also holds the key of the graph, a hash of its
+ * snapshot. The polynomial is only trusted if the loaded graph has the same
+ * key, so a damaged or hand-edited file is recomputed instead.
+ *
+ * Included from chrompoly.c after scheduler.c, for GraphSnapshot.
+ */
+#include "array.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CANVAS_FILE_MAGIC "CHROMCNV"
+#define CANVAS_FILE_VERSION 1
+#define CANVAS_FILE_BYTE_ORDER 0x01020304u
+
+typedef enum {
+  SECTION_NODES = 1,
+  SECTION_EDGES = 2,
+  SECTION_POLYNOMIAL = 3
+} CanvasSectionKind;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t section_count;
+  uint32_t reserved;
+  uint64_t key;
+} CanvasFileHeader;
+
+typedef struct {
+  uint32_t kind;
+  uint32_t reserved;
+  uint64_t count;  // Of nodes, edges or coefficients
+  uint64_t offset; // Of the data, from the start of the file
+} CanvasFileSection;
+
+/* A canvas file opened for reading, whose arrays point into its mapping */
+typedef struct {
+  void *data;
+  size_t size;
+  uint64_t key;
+  const int32_t *nodes; // x0, y0, x1, y1, ...
+  uint64_t node_count;
+  const int32_t *edges; // u0, v0, u1, v1, ...
+  uint64_t edge_count;
+  const int64_t *polynomial; // NULL if the file has none
+  uint64_t coeff_count;
+} CanvasFile;
+
+/* FNV-1a hash of the snapshot, which equal graphs share */
+uint64_t snapshot_key(GraphSnapshot *graph) {
+  uint64_t hash = 14695981039346656037ULL;
+  int values = 2 * array_size(&graph->edges) + 1;
+  for (int i = 0; i < values; i++) {
+    uint32_t value = i == 0 ? graph->n
+                     : i % 2 ? array_at(&graph->edges, i / 2).start_idx
+                             : array_at(&graph->edges, i / 2 - 1).end_idx;
+    for (int byte = 0; byte < 4; byte++) {
+      hash ^= value >> (8 * byte) & 0xff;
+      hash *= 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+/*
+ * Write the graph with vertex positions xy (x0, y0, x1, y1, ...) and edges
+ * to path, with its polynomial P unless that is NULL, and the key of the
+ * graph. The file is replaced at once, so it is never left half written.
+ * Returns false, after printing why, if it cannot be written.
+ */
+bool canvas_file_write(const char *path, array_int *xy, array_edge *edges,
+                       array_ll *P, uint64_t key) {
+  CanvasFileHeader header = {.version = CANVAS_FILE_VERSION,
+                             .byte_order = CANVAS_FILE_BYTE_ORDER,
+                             .section_count = P != NULL ? 3 : 2,
+                             .key = key};
+  memcpy(header.magic, CANVAS_FILE_MAGIC, sizeof(header.magic));
+  CanvasFileSection sections[3] = {
+      {SECTION_NODES, 0, array_size(xy) / 2},
+      {SECTION_EDGES, 0, array_size(edges)},
+      {SECTION_POLYNOMIAL, 0, P != NULL ? array_size(P) : 0}};
+  // Every element is 8 bytes, so the data of each section stays aligned
+  uint64_t offset =
+      sizeof(header) + header.section_count * sizeof(CanvasFileSection);
+  for (int i = 0; i < header.section_count; i++) {
+    sections[i].offset = offset;
+    offset += 8 * sections[i].count;
+  }
+
+  char temp_path[1024];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+  FILE *file = fopen(temp_path, "wb");
+  if (file == NULL) {
+    printf("Failed to create %s\n", temp_path);
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(sections, sizeof(CanvasFileSection), header.section_count,
+                   file) == header.section_count;
+  array_foreach(xy, int v) {
+    int32_t value = v;
+    ok = ok && fwrite(&value, sizeof(value), 1, file) == 1;
+  }
+  array_foreach(edges, Edge edge) {
+    int32_t ends[2] = {edge.start_idx, edge.end_idx};
+    ok = ok && fwrite(ends, sizeof(ends), 1, file) == 1;
+  }
+  if (P != NULL) {
+    array_foreach(P, long long coeff) {
+      int64_t value = coeff;
+      ok = ok && fwrite(&value, sizeof(value), 1, file) == 1;
+    }
+  }
+  ok = fclose(file) == 0 && ok;
+  if (ok)
+    ok = rename(temp_path, path) == 0;
+  if (!ok) {
+    printf("Failed to write %s\n", path);
+    remove(temp_path);
+  }
+  return ok;
+}
+
+/* Map the whole file at path into file->data. Returns false if it cannot be
+read. */
+bool _canvas_file_map(const char *path, CanvasFile *file) {
+#ifdef _WIN32
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+    return false;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  file->data = malloc(size > 0 ? size : 1);
+  file->size = size;
+  bool ok = size >= 0 && fread(file->data, 1, size, f) == size;
+  fclose(f);
+  return ok;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0 && st.st_size > 0;
+  if (ok) {
+    file->size = st.st_size;
+    file->data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ok = file->data != MAP_FAILED;
+    if (!ok)
+      file->data = NULL;
+  }
+  close(fd);
+  return ok;
+#endif
+}
+
+void canvas_file_close(CanvasFile *file) {
+  if (file->data == NULL)
+    return;
+#ifdef _WIN32
+  free(file->data);
+#else
+  munmap(file->data, file->size);
+#endif
+  file->data = NULL;
+}
+
+/* Open the canvas file at path for reading. Returns false, after printing
+why, if it cannot be read or is not a valid canvas file. */
+bool canvas_file_open(const char *path, CanvasFile *file) {
+  memset(file, 0, sizeof(*file));
+  if (!_canvas_file_map(path, file)) {
+    printf("Failed to read %s\n", path);
+    canvas_file_close(file);
+    return false;
+  }
+  const char *data = file->data;
+  CanvasFileHeader header;
+  bool ok = file->size >= sizeof(header);
+  if (ok) {
+    memcpy(&header, data, sizeof(header));
+    ok = memcmp(header.magic, CANVAS_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+         header.version == CANVAS_FILE_VERSION &&
+         header.byte_order == CANVAS_FILE_BYTE_ORDER &&
+         header.section_count <=
+             (file->size - sizeof(header)) / sizeof(CanvasFileSection);
+  }
+  bool has_nodes = false;
+  for (int i = 0; ok && i < header.section_count; i++) {
+    CanvasFileSection section;
+    memcpy(&section,
+           data + sizeof(header) + i * sizeof(CanvasFileSection),
+           sizeof(section));
+    ok = section.offset % 8 == 0 && section.offset <= file->size &&
+         section.count <= (file->size - section.offset) / 8;
+    if (!ok)
+      break;
+    const void *start = data + section.offset;
+    switch (section.kind) {
+    case SECTION_NODES:
+      file->nodes = start;
+      file->node_count = section.count;
+      has_nodes = true;
+      ok = section.count <= INT32_MAX;
+      break;
+    case SECTION_EDGES:
+      file->edges = start;
+      file->edge_count = section.count;
+      break;
+    case SECTION_POLYNOMIAL:
+      file->polynomial = start;
+      file->coeff_count = section.count;
+      break;
+    }
+  }
+  ok = ok && has_nodes;
+  for (uint64_t i = 0; ok && i < 2 * file->edge_count; i++)
+    ok = file->edges[i] >= 0 && file->edges[i] < file->node_count;
+  if (!ok) {
+    printf("%s is not a valid canvas file\n", path);
+    canvas_file_close(file);
+    return false;
+  }
+  file->key = header.key;
+  return true;
+}
+
+/* Add the edges of file to edges, sorted, each as u < v. A damaged or
+hand-edited file may have loops and repeated edges, which the canvas never
+holds: they are dropped, as import_edge_list() does. */
+void canvas_file_edges(CanvasFile *file, array_edge *edges) {
+  for (uint64_t i = 0; i < file->edge_count; i++) {
+    int a = file->edges[2 * i], b = file->edges[2 * i + 1];
+    if (a != b)
+      array_add(edges, ((Edge){a < b ? a : b, a < b ? b : a}));
+  }
+  array_sort(edges, cmp_edge);
+  int kept = 0;
+  array_foreach(edges, Edge edge) {
+    if (kept == 0 || !edge_eq(edge, array_at(edges, kept - 1)))
+      array_at(edges, kept++) = edge;
+  }
+  edges->size = kept;
+}
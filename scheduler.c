@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Coalesces bursts of graph edits into a single recomputation.
+ * The render loop reports every edit, but the graph is only handed over for
+ * computation once no edit has happened for a quiet period and no mouse
+ * button is held. The running computation is superseded only if the new
+ * snapshot really differs from the graph being computed.
+ *
+ * Included from chrompoly.c after submap.c, for the Edge type.
+ */
+#include "array.h"
+
+#define DEFAULT_QUIET_PERIOD 0.15 // seconds
+
+/* A copy of the graph, with every edge stored as start_idx < end_idx and the
+edges sorted, so that equal graphs have equal snapshots. */
+typedef struct {
+  int n;
+  array_edge edges;
+} GraphSnapshot;
+
+int cmp_edge(const void *a, const void *b) {
+  Edge x = *((Edge *)a);
+  Edge y = *((Edge *)b);
+  if (x.start_idx != y.start_idx)
+    return (x.start_idx > y.start_idx) - (x.start_idx < y.start_idx);
+  return (x.end_idx > y.end_idx) - (x.end_idx < y.end_idx);
+}
+
+GraphSnapshot snapshot_graph(int n, array_edge *edges) {
+  GraphSnapshot s = {.n = n};
+  array_init(&s.edges);
+  array_foreach(edges, Edge edge) {
+    array_add(&s.edges, ((edge.start_idx < edge.end_idx)
+                             ? edge
+                             : (Edge){edge.end_idx, edge.start_idx}));
+  }
+  array_sort(&s.edges, cmp_edge);
+  return s;
+}
+
+bool snapshot_eq(GraphSnapshot *a, GraphSnapshot *b) {
+  return a->n == b->n && array_eq(&a->edges, &b->edges, edge_eq);
+}
+
+void snapshot_copy(GraphSnapshot *dest, GraphSnapshot *src) {
+  dest->n = src->n;
+  array_clear(&dest->edges);
+  array_foreach(&src->edges, Edge edge) { array_add(&dest->edges, edge); }
+}
+
+typedef struct {
+  double quiet_period;
+  double last_edit_time;
+  double first_edit_time; // Of the edits not yet handed over
+  bool dirty;             // Edits not yet handed over
+  bool has_current;
+  GraphSnapshot current; // Graph last handed over for computation
+} EditScheduler;
+
+void scheduler_init(EditScheduler *s, double quiet_period) {
+  memset(s, 0, sizeof(*s));
+  s->quiet_period = quiet_period;
+  array_init(&s->current.edges);
+}
+
+void scheduler_term(EditScheduler *s) { array_term(&s->current.edges); }
+
+/* Called by the render loop whenever the user edits the graph */
+void scheduler_note_edit(EditScheduler *s, double now) {
+  if (!s->dirty)
+    s->first_edit_time = now;
+  s->dirty = true;
+  s->last_edit_time = now;
+}
+
+/*
+ * Called by the render loop every frame. Returns true once the edits have
+ * settled, i.e. no edit for the quiet period and no input held. The caller
+ * then takes a snapshot of the graph and offers it to scheduler_accept().
+ */
+bool scheduler_settled(EditScheduler *s, double now, bool input_held) {
+  if (!s->dirty || input_held || now - s->last_edit_time < s->quiet_period)
+    return false;
+  s->dirty = false;
+  return true;
+}
+
+/*
+ * Returns true if snapshot should be submitted as the new foreground job,
+ * which supersedes the previous one. Returns false, and frees snapshot, if
+ * the edits cancelled out (e.g. a node added and deleted again) so that the
+ * graph equals the one last handed over.
+ */
+bool scheduler_accept(EditScheduler *s, GraphSnapshot *snapshot) {
+  if (s->has_current && snapshot_eq(snapshot, &s->current)) {
+    array_term(&snapshot->edges);
+    return false;
+  }
+  snapshot_copy(&s->current, snapshot);
+  s->has_current = true;
+  return true;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * How much each single-edge edit would change the chromatic polynomial. For
+ * any pair of vertices u, v, with G / uv the graph where they are merged:
+ *
+ *   P(G - uv) = P(G) + P(G / uv)   if uv is an edge,
+ *   P(G + uv) = P(G) - P(G / uv)   if it is not.
+ *
+ * So P(G) and the polynomials of the n(n-1)/2 minors G / uv give the result
+ * of every edit, without computing any edited graph. The minors share most of
+ * their subgraphs, which the deletion-contraction engine reuses through its
+ * memo table.
+ *
+ * The heat of an edit is the share of the colourings of G with chi(G) colours
+ * that it adds or removes, P(G / uv)(k) / P(G)(k) with k = chi(G): removing
+ * an edge adds colourings, and adding a non-edge forbids those where u and v
+ * have the same colour. An edit that changes chi(G) has the most heat.
+ *
+ * Included from chrompoly.c after scheduler.c, for GraphSnapshot, and eval.c,
+ * for poly_eval_exact().
+ */
+#include "array.h"
+#include <stdbool.h>
+
+typedef struct {
+  int u, v;         // Vertices, u < v
+  bool edge;        // Removing the edge uv, else adding it
+  bool changes_chi; // The edit lowers or raises chi(G)
+  float heat;       // From 0 to 1
+} EdgeHeat;
+array_def(EdgeHeat, edge_heat);
+
+/* Snapshot of graph with the vertices u < v merged into u, and the vertices
+after v numbered one lower */
+GraphSnapshot snapshot_contract(GraphSnapshot *graph, int u, int v) {
+  array_edge edges;
+  array_init(&edges);
+  array_foreach(&graph->edges, Edge edge) {
+    int a = edge.start_idx == v ? u : edge.start_idx;
+    int b = edge.end_idx == v ? u : edge.end_idx;
+    if (a == b)
+      continue;
+    array_add(&edges, ((Edge){a - (a > v), b - (b > v)}));
+  }
+  GraphSnapshot s = snapshot_graph(graph->n - 1, &edges);
+  array_term(&edges);
+  // Edges to both u and v are now the same edge
+  int kept = 0;
+  array_foreach(&s.edges, Edge edge) {
+    if (kept == 0 || !edge_eq(edge, array_at(&s.edges, kept - 1)))
+      array_at(&s.edges, kept++) = edge;
+  }
+  s.edges.size = kept;
+  return s;
+}
+
+/* The smallest k with P(k) > 0, or 0 for the empty graph */
+int polynomial_chi(array_ll *P) {
+  int chi = 0;
+  for (int k = 1; k <= array_size(P) && chi == 0; k++) {
+    BigInt value = poly_eval_exact(P, k);
+    if (bigint_sign(&value) > 0)
+      chi = k;
+    bigint_term(&value);
+  }
+  return chi;
+}
+
+/* The heat of adding or removing uv, given the polynomial minor_P of G / uv,
+chi = chi(G) and colourings = P(G)(chi) */
+EdgeHeat edge_heat(int u, int v, bool edge, array_ll *minor_P, int chi,
+                   BigInt *colourings) {
+  EdgeHeat heat = {.u = u, .v = v, .edge = edge};
+  BigInt value = poly_eval_exact(minor_P, chi);
+  double share = bigint_to_double(&value) / bigint_to_double(colourings);
+  if (edge) {
+    // chi(G - uv) < chi iff G / uv has colourings with chi - 1 colours, as
+    // G has none
+    bigint_term(&value);
+    value = poly_eval_exact(minor_P, chi - 1);
+    heat.changes_chi = bigint_sign(&value) > 0;
+    heat.heat = heat.changes_chi ? 1 : share / (1 + share);
+  } else {
+    // chi(G + uv) > chi iff u and v have the same colour in every colouring
+    // of G with chi colours
+    bigint_sub(&value, colourings);
+    heat.changes_chi = bigint_is_zero(&value);
+    heat.heat = heat.changes_chi || share > 1 ? 1 : share;
+  }
+  bigint_term(&value);
+  return heat;
+}
@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Separator engine, for graphs that split along small separators, as planar
+ * graphs do: those with n vertices have separators of O(sqrt n) vertices.
+ *
+ * The vertices are swept in an order chosen so that the frontier, the swept
+ * vertices that still have unswept neighbours, stays small. The frontier
+ * separates the swept part of the graph from the rest, and the engine keeps a
+ * table of the ways the swept part can be coloured, by the partition of the
+ * frontier into colour classes: for each partition, the number of colourings
+ * inducing it, a polynomial in x. Sweeping vertex v extends each partition by
+ * putting v in a class without neighbours of v, or in a class of its own,
+ * whose colour differs from the k classes of the frontier: x - k ways.
+ * Vertices leave the frontier once all their neighbours are swept, and
+ * partitions that become equal are merged by adding their polynomials. Once
+ * every vertex is swept, the single partition left, of the empty frontier,
+ * counts all colourings.
+ *
+ * A table has at most Bell(w) partitions for a frontier of w vertices, so
+ * graphs of 60 or more vertices are computed quickly if they have a sweep
+ * whose frontier stays around 10. Coefficients are computed modulo 2^64,
+ * which is exact for every result that array_int can hold.
+ *
+ * Included from chrompoly.c after kernels.c, for _mix64() and the engine
+ * types, and poly.c, for poly_add_mul_linear().
+ */
+#include "array.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SEPARATOR_MAX_WIDTH 16     // Frontier vertices, a 4-bit label each
+#define SEPARATOR_MIN_VERTICES 12  // Smaller graphs go to the kernel or delcon
+#define SEPARATOR_MAX_VERTICES 128 // Larger graphs are not tried
+
+typedef struct {
+  int n;
+  array_int order;      // Vertices in the order they are swept
+  array_int neighbours; // Of vertex v at [first[v], first[v+1])
+  array_int first;
+  int width; // Largest frontier, counting the vertex being swept
+
+  int step;           // Vertices swept so far
+  array_int frontier; // Vertices in slot order
+  array_int unswept;  // Neighbours of each vertex still to sweep
+  // Partitions of the frontier, with the label of each slot in 4 bits, and
+  // the n + 1 coefficients of each, of x^0 first
+  array_64 keys, coeffs;
+  // The table after the current step, with an open addressing hash table of
+  // indices into next_keys, or -1
+  array_64 next_keys, next_coeffs;
+  int *index;
+  int index_mask;
+  int next; // Partition of keys to extend next
+  // Of the current step: the slot of each frontier vertex after it, or -1,
+  // with the swept vertex last, and the slots of its neighbours
+  int new_slot[SEPARATOR_MAX_WIDTH];
+  int new_width;
+  unsigned neighbour_slots;
+  bool aborted;
+  array_ll *P;
+} SeparatorTask;
+
+/* Neighbours of each vertex, without repeated edges */
+void _separator_adjacency(SeparatorTask *task, array_edge *edges) {
+  int n = task->n;
+  bool *adj = calloc(n * n, sizeof(bool));
+  array_foreach(edges, Edge edge) {
+    adj[edge.start_idx * n + edge.end_idx] = true;
+    adj[edge.end_idx * n + edge.start_idx] = true;
+  }
+  array_init(&task->neighbours);
+  array_init(&task->first);
+  for (int v = 0; v < n; v++) {
+    array_add(&task->first, array_size(&task->neighbours));
+    for (int u = 0; u < n; u++) {
+      if (u != v && adj[v * n + u])
+        array_add(&task->neighbours, u);
+    }
+  }
+  array_add(&task->first, array_size(&task->neighbours));
+  free(adj);
+}
+
+#define _neighbours_foreach(task, v, u)                                        \
+  for (int _j = array_at(&(task)->first, v), u;                                \
+       _j < array_at(&(task)->first, (v) + 1) &&                               \
+       ((u = array_at(&(task)->neighbours, _j)), true);                        \
+       _j++)
+
+/* Breadth-first distances from root, or n for vertices it does not reach */
+void _separator_distances(SeparatorTask *task, int root, int *distance,
+                          int *queue) {
+  int n = task->n, head = 0, tail = 0;
+  for (int v = 0; v < n; v++)
+    distance[v] = n;
+  queue[tail++] = root;
+  distance[root] = 0;
+  while (head < tail) {
+    int v = queue[head++];
+    _neighbours_foreach(task, v, u) {
+      if (distance[u] == n) {
+        distance[u] = distance[v] + 1;
+        queue[tail++] = u;
+      }
+    }
+  }
+}
+
+/*
+ * Sweep greedily from root into order: each vertex swept next is one that
+ * leaves the smallest frontier, then one with the most swept neighbours, then
+ * the nearest to root, so that the sweep moves across the graph like a wave.
+ * Returns the width of the sweep, and the sum of its frontiers in cost.
+ */
+int _separator_sweep_from(SeparatorTask *task, int root, int *order,
+                          int *cost) {
+  int n = task->n, frontier = 0, width = 0;
+  int *distance = malloc(n * sizeof(int));
+  int *unswept = malloc(n * sizeof(int));
+  int *swept_neighbours = calloc(n, sizeof(int));
+  bool *swept = calloc(n, sizeof(bool));
+  _separator_distances(task, root, distance, unswept);
+  for (int v = 0; v < n; v++)
+    unswept[v] = array_at(&task->first, v + 1) - array_at(&task->first, v);
+  *cost = 0;
+  for (int step = 0; step < n; step++) {
+    int best = step == 0 ? root : -1, best_size = 0;
+    for (int v = 0; v < n; v++) {
+      if (swept[v] || (step == 0 && v != root))
+        continue;
+      int size = frontier + (unswept[v] > 0);
+      _neighbours_foreach(task, v, u) { size -= swept[u] && unswept[u] == 1; }
+      if (best < 0 || v == best || size < best_size ||
+          (size == best_size &&
+           (swept_neighbours[v] > swept_neighbours[best] ||
+            (swept_neighbours[v] == swept_neighbours[best] &&
+             distance[v] < distance[best])))) {
+        best = v;
+        best_size = size;
+      }
+    }
+    if (frontier + 1 > width)
+      width = frontier + 1;
+    *cost += frontier + 1;
+    frontier = best_size;
+    swept[best] = true;
+    _neighbours_foreach(task, best, u) {
+      unswept[u]--;
+      swept_neighbours[u]++;
+    }
+    order[step] = best;
+  }
+  free(distance);
+  free(unswept);
+  free(swept_neighbours);
+  free(swept);
+  return width;
+}
+
+/* The order of the sweep: the narrowest of the greedy sweeps from each vertex.
+Returns its width. */
+int _separator_order(SeparatorTask *task) {
+  int n = task->n, best_width = n + 1, best_cost = 0;
+  int *order = malloc(n * sizeof(int));
+  array_init(&task->order);
+  for (int root = 0; root < n; root++) {
+    int cost;
+    int width = _separator_sweep_from(task, root, order, &cost);
+    if (width < best_width || (width == best_width && cost < best_cost)) {
+      best_width = width;
+      best_cost = cost;
+      array_clear(&task->order);
+      for (int i = 0; i < n; i++)
+        array_add(&task->order, order[i]);
+    }
+  }
+  free(order);
+  return best_width;
+}
+
+/*
+ * Plan a sweep of the graph with n vertices and the given edges. Returns
+ * false, leaving nothing to free, if its frontier would exceed
+ * SEPARATOR_MAX_WIDTH. Otherwise the sweep is ready to compute the chromatic
+ * polynomial into P (which must hold n zeroed coefficients, as in
+ * get_chromatic_polynomial()). edges and P must outlive the task.
+ */
+bool separator_task_start(SeparatorTask *task, int n, array_edge *edges,
+                          array_ll *P) {
+  task->n = n;
+  task->P = P;
+  _separator_adjacency(task, edges);
+  task->width = _separator_order(task);
+  if (task->width > SEPARATOR_MAX_WIDTH) {
+    array_term(&task->order);
+    array_term(&task->neighbours);
+    array_term(&task->first);
+    return false;
+  }
+  task->step = 0;
+  task->next = -1;
+  task->aborted = false;
+  array_init(&task->frontier);
+  array_init(&task->unswept);
+  for (int v = 0; v < n; v++) {
+    array_add(&task->unswept,
+              array_at(&task->first, v + 1) - array_at(&task->first, v));
+  }
+  array_init(&task->keys);
+  array_init(&task->coeffs);
+  array_init(&task->next_keys);
+  array_init(&task->next_coeffs);
+  // Before the sweep, the empty frontier has one partition, coloured once
+  array_add(&task->keys, 0);
+  array_add(&task->coeffs, 1);
+  for (int i = 0; i < n; i++)
+    array_add(&task->coeffs, 0);
+  task->index_mask = 1023;
+  task->index = malloc((task->index_mask + 1) * sizeof(int));
+  return true;
+}
+
+/* Work out where the frontier vertices go when the next vertex is swept */
+void _separator_begin_step(SeparatorTask *task) {
+  int v = array_at(&task->order, task->step);
+  task->neighbour_slots = 0;
+  array_enumerate(&task->frontier, slot, int u) {
+    _neighbours_foreach(task, v, w) {
+      if (w == u)
+        task->neighbour_slots |= 1u << slot;
+    }
+  }
+  _neighbours_foreach(task, v, u) { array_at(&task->unswept, u)--; }
+  int width = array_size(&task->frontier);
+  task->new_width = 0;
+  for (int slot = 0; slot <= width; slot++) {
+    int u = slot < width ? array_at(&task->frontier, slot) : v;
+    task->new_slot[slot] =
+        array_at(&task->unswept, u) > 0 ? task->new_width++ : -1;
+  }
+  memset(task->index, -1, (task->index_mask + 1) * sizeof(int));
+  task->next = 0;
+}
+
+/* The frontier and table after the step */
+void _separator_end_step(SeparatorTask *task) {
+  int v = array_at(&task->order, task->step);
+  array_int frontier;
+  array_init(&frontier);
+  array_enumerate(&task->frontier, slot, int u) {
+    if (task->new_slot[slot] >= 0)
+      array_add(&frontier, u);
+  }
+  if (task->new_slot[array_size(&task->frontier)] >= 0)
+    array_add(&frontier, v);
+  array_term(&task->frontier);
+  task->frontier = frontier;
+  array_64 keys = task->keys, coeffs = task->coeffs;
+  task->keys = task->next_keys;
+  task->coeffs = task->next_coeffs;
+  task->next_keys = keys;
+  task->next_coeffs = coeffs;
+  array_clear(&task->next_keys);
+  array_clear(&task->next_coeffs);
+  task->step++;
+  task->next = -1;
+}
+
+/* Index of the partition key in the next table, which it is added to with
+zero coefficients if it is not there yet */
+int _separator_find(SeparatorTask *task, uint64_t key) {
+  int stride = task->n + 1;
+  if (2 * array_size(&task->next_keys) > task->index_mask) {
+    // Keep the hash table at most half full
+    task->index_mask = 2 * task->index_mask + 1;
+    free(task->index);
+    task->index = malloc((task->index_mask + 1) * sizeof(int));
+    memset(task->index, -1, (task->index_mask + 1) * sizeof(int));
+    array_enumerate(&task->next_keys, i, uint64_t k) {
+      int h = _mix64(k) & task->index_mask;
+      while (task->index[h] >= 0)
+        h = (h + 1) & task->index_mask;
+      task->index[h] = i;
+    }
+  }
+  int h = _mix64(key) & task->index_mask;
+  for (; task->index[h] >= 0; h = (h + 1) & task->index_mask) {
+    if (array_at(&task->next_keys, task->index[h]) == key)
+      return task->index[h];
+  }
+  task->index[h] = array_size(&task->next_keys);
+  array_add(&task->next_keys, key);
+  for (int i = 0; i < stride; i++)
+    array_add(&task->next_coeffs, 0);
+  return task->index[h];
+}
+
+/* Add the colourings of partition i of the table, extended by the swept
+vertex, to the next table */
+void _separator_extend(SeparatorTask *task, int i) {
+  int width = array_size(&task->frontier), stride = task->n + 1;
+  uint64_t key = array_at(&task->keys, i);
+  int labels[SEPARATOR_MAX_WIDTH];
+  int classes = 0;
+  unsigned forbidden = 0; // Classes with a neighbour of the swept vertex
+  for (int slot = 0; slot < width; slot++) {
+    labels[slot] = key >> (4 * slot) & 15;
+    if (labels[slot] + 1 > classes)
+      classes = labels[slot] + 1;
+    if (task->neighbour_slots >> slot & 1)
+      forbidden |= 1u << labels[slot];
+  }
+  for (int label = 0; label <= classes; label++) {
+    if (label < classes && (forbidden >> label & 1))
+      continue;
+    labels[width] = label;
+    // Labels of the new frontier, renumbered in order of first occurrence
+    int renumbered[SEPARATOR_MAX_WIDTH + 1];
+    memset(renumbered, -1, sizeof(renumbered));
+    int count = 0;
+    uint64_t next_key = 0;
+    for (int slot = 0; slot <= width; slot++) {
+      int new_slot = task->new_slot[slot];
+      if (new_slot < 0)
+        continue;
+      if (renumbered[labels[slot]] < 0)
+        renumbered[labels[slot]] = count++;
+      next_key |= (uint64_t)renumbered[labels[slot]] << (4 * new_slot);
+    }
+    int j = _separator_find(task, next_key);
+    uint64_t *from = &array_at(&task->coeffs, i * stride);
+    uint64_t *to = &array_at(&task->next_coeffs, j * stride);
+    if (label < classes) {
+      for (int c = 0; c < stride; c++)
+        to[c] += from[c];
+    } else {
+      // A new colour, other than those of the classes: times x - classes
+      poly_add_mul_linear(to, from, stride, classes);
+    }
+  }
+}
+
+/* Run the sweep until it is finished or budget is used up. Returns whether it
+is finished, which includes being aborted through run->cancel. */
+bool separator_task_step(SeparatorTask *task, EngineRun *run,
+                         EngineBudget *budget) {
+  while (task->step < task->n) {
+    if (task->next < 0)
+      _separator_begin_step(task);
+    while (task->next < array_size(&task->keys)) {
+      if (run->cancel) {
+        task->aborted = true;
+        return true;
+      }
+      if (engine_yield(budget))
+        return false;
+      _separator_extend(task, task->next++);
+    }
+    _separator_end_step(task);
+  }
+  return true;
+}
+
+/* Free the task, after writing the polynomial into P. Returns false if it was
+aborted, and P is then incomplete. */
+bool separator_task_finish(SeparatorTask *task) {
+  if (!task->aborted) {
+    // The swept graph is the whole graph, and the frontier is empty. The
+    // coefficients are left modulo 2^64, for poly_is_exact() to check.
+    for (int i = 1; i <= task->n; i++)
+      array_at(task->P, i - 1) = (long long)array_at(&task->coeffs, i);
+  }
+  array_term(&task->order);
+  array_term(&task->neighbours);
+  array_term(&task->first);
+  array_term(&task->frontier);
+  array_term(&task->unswept);
+  array_term(&task->keys);
+  array_term(&task->coeffs);
+  array_term(&task->next_keys);
+  array_term(&task->next_coeffs);
+  free(task->index);
+  return !task->aborted;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Edit sessions, recorded to a file so that they can be replayed without a
+ * window, to benchmark the scheduler and the engines on what users actually
+ * do. A session is a text file with one edit per line: the seconds since
+ * recording started, then the edit.
+ *
+ *   0.000 add 120 340   adds node 0 at (120, 340)
+ *   0.820 add 300 310   adds node 1
+ *   1.504 edge 0 1      adds an edge between nodes 0 and 1
+ *   3.010 delete 0
+ *
+ * Nodes are numbered in the order in which they were added during the
+ * session. A recording of an imported graph starts with its nodes and edges,
+ * at time 0. Lines starting with '#' are comments.
+ *
+ * Settings come from the environment and are overridden by the command line:
+ *
+ *   --canvas FILE        CHROMPOLY_CANVAS        canvas file, see savefile.c
+ *   --record FILE        CHROMPOLY_RECORD        record the session
+ *   --replay FILE        CHROMPOLY_REPLAY        replay a session headless
+ *   --replay-speed X     CHROMPOLY_REPLAY_SPEED  times the original pace
+ *
+ * Included from chrompoly.c after canvas.c, for NodeId.
+ */
+#include "array.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum { EDIT_ADD_NODE, EDIT_ADD_EDGE, EDIT_DELETE_NODE } EditKind;
+
+const char *edit_kind_names[] = {"add", "edge", "delete"};
+
+typedef struct {
+  double time; // Seconds since the start of the session
+  EditKind kind;
+  int a, b; // Position of a new node, else node numbers (b unused to delete)
+} SessionEdit;
+array_def(SessionEdit, session_edit);
+
+typedef struct {
+  const char *canvas_path; // NULL to not keep the canvas between runs
+  const char *record_path; // NULL to not record
+  const char *replay_path; // NULL to run the window
+  double replay_speed;
+} SessionConfig;
+
+typedef struct {
+  FILE *file; // NULL when not recording
+  double start;
+  int node_count;
+  array_int number_of_slot; // Canvas slot -> number of the node in it
+} SessionRecorder;
+
+/* Apply the setting name = value, where name is an option without its
+leading "--". Returns false, after printing why, if it is invalid. */
+bool _session_set(SessionConfig *config, const char *name, const char *value) {
+  if (strcmp(name, "canvas") == 0) {
+    config->canvas_path = value;
+  } else if (strcmp(name, "record") == 0) {
+    config->record_path = value;
+  } else if (strcmp(name, "replay") == 0) {
+    config->replay_path = value;
+  } else if (strcmp(name, "replay-speed") == 0) {
+    char *end;
+    errno = 0;
+    config->replay_speed = strtod(value, &end);
+    if (errno != 0 || end == value || *end != '\0' ||
+        !(config->replay_speed > 0)) {
+      printf("Invalid value for %s: %s\n", name, value);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Read the settings given in the environment. Returns false, after printing
+why, if one is invalid. */
+bool session_from_env(SessionConfig *config) {
+  *config = (SessionConfig){.replay_speed = 1};
+  const char *vars[][2] = {{"CHROMPOLY_CANVAS", "canvas"},
+                           {"CHROMPOLY_RECORD", "record"},
+                           {"CHROMPOLY_REPLAY", "replay"},
+                           {"CHROMPOLY_REPLAY_SPEED", "replay-speed"}};
+  for (int i = 0; i < sizeof(vars) / sizeof(vars[0]); i++) {
+    const char *value = getenv(vars[i][0]);
+    if (value != NULL && !_session_set(config, vars[i][1], value))
+      return false;
+  }
+  return true;
+}
+
+/* If args[0] is a session option, apply it with its value args[1] and return
+2. Returns 0 if it is not a session option, and -1, after printing why, if
+it is invalid. */
+int session_parse_option(SessionConfig *config, int count, char **args) {
+  const char *options[] = {"--canvas", "--record", "--replay",
+                           "--replay-speed"};
+  for (int i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+    if (strcmp(args[0], options[i]) != 0)
+      continue;
+    if (count < 2) {
+      printf("Missing value for %s\n", args[0]);
+      return -1;
+    }
+    return _session_set(config, options[i] + 2, args[1]) ? 2 : -1;
+  }
+  return 0;
+}
+
+/* Start recording into the file at path, at time now. Returns false, after
+printing why, if it cannot be created. */
+bool session_record_start(SessionRecorder *r, const char *path, double now) {
+  r->file = fopen(path, "w");
+  if (r->file == NULL) {
+    printf("Failed to create %s\n", path);
+    return false;
+  }
+  r->start = now;
+  r->node_count = 0;
+  array_init(&r->number_of_slot);
+  fprintf(r->file, "# chrompoly session\n");
+  return true;
+}
+
+void session_record_stop(SessionRecorder *r) {
+  if (r->file == NULL)
+    return;
+  fclose(r->file);
+  r->file = NULL;
+  array_term(&r->number_of_slot);
+}
+
+void session_record_add_node(SessionRecorder *r, double now, NodeId id, int x,
+                             int y) {
+  if (r->file == NULL)
+    return;
+  while (array_size(&r->number_of_slot) <= id.slot)
+    array_add(&r->number_of_slot, -1);
+  array_at(&r->number_of_slot, id.slot) = r->node_count++;
+  fprintf(r->file, "%.6f add %d %d\n", now - r->start, x, y);
+}
+
+void session_record_add_edge(SessionRecorder *r, double now, NodeId a,
+                             NodeId b) {
+  if (r->file == NULL)
+    return;
+  fprintf(r->file, "%.6f edge %d %d\n", now - r->start,
+          array_at(&r->number_of_slot, a.slot),
+          array_at(&r->number_of_slot, b.slot));
+}
+
+void session_record_delete_node(SessionRecorder *r, double now, NodeId id) {
+  if (r->file == NULL)
+    return;
+  fprintf(r->file, "%.6f delete %d\n", now - r->start,
+          array_at(&r->number_of_slot, id.slot));
+}
+
+/* Read the session at path into edits, which must be initialised. Returns
+false, after printing why, if it cannot be read or an edit is invalid. */
+bool session_load(const char *path, array_session_edit *edits) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    printf("Failed to open %s\n", path);
+    return false;
+  }
+  char line[256];
+  int line_number = 0, node_count = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file) != NULL) {
+    line_number++;
+    if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+      continue;
+    SessionEdit edit = {0};
+    char kind[16];
+    int fields = sscanf(line, "%lf %15s %d %d", &edit.time, kind, &edit.a,
+                        &edit.b);
+    ok = false;
+    if (fields >= 3 && strcmp(kind, "delete") == 0) {
+      edit.kind = EDIT_DELETE_NODE;
+      ok = edit.a >= 0 && edit.a < node_count;
+    } else if (fields == 4 && strcmp(kind, "add") == 0) {
+      edit.kind = EDIT_ADD_NODE;
+      node_count++;
+      ok = true;
+    } else if (fields == 4 && strcmp(kind, "edge") == 0) {
+      edit.kind = EDIT_ADD_EDGE;
+      ok = edit.a >= 0 && edit.a < node_count && edit.b >= 0 &&
+           edit.b < node_count && edit.a != edit.b;
+    }
+    ok &= edit.time >= 0 &&
+          (array_size(edits) == 0 || edit.time >= array_last(edits).time);
+    if (ok)
+      array_add(edits, edit);
+    else
+      printf("%s:%d: invalid edit\n", path, line_number);
+  }
+  fclose(file);
+  return ok;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Uniform grid spatial index over points, for hit-testing nodes and for
+ * rectangle queries such as selection and viewport culling.
+ * The plane is cut into square cells, and only non-empty cells are stored, in
+ * an open addressing hash table keyed by cell coordinates. A point or radius
+ * query only looks at the few cells overlapping the query area, so its cost
+ * depends on the local density of points, not on their total number.
+ */
+#include "array.h"
+#include <math.h>
+
+typedef struct {
+  int id;
+  float x;
+  float y;
+} SpatialItem;
+array_def(SpatialItem, spatial_item);
+
+typedef struct {
+  bool used;
+  int cx;
+  int cy;
+  array_spatial_item items;
+} SpatialCell;
+
+typedef struct {
+  float cell_size;
+  int cell_count; // Cells in use, including ones that became empty
+  int capacity;   // Always a power of 2
+  SpatialCell *cells;
+} SpatialIndex;
+
+void spatial_init(SpatialIndex *index, float cell_size) {
+  index->cell_size = cell_size;
+  index->cell_count = 0;
+  index->capacity = 64;
+  index->cells = calloc(index->capacity, sizeof(SpatialCell));
+}
+
+void spatial_term(SpatialIndex *index) {
+  for (int i = 0; i < index->capacity; i++)
+    array_term(&index->cells[i].items);
+  free(index->cells);
+  index->cells = NULL;
+  index->capacity = index->cell_count = 0;
+}
+
+/* Remove every item, keeping the allocated cells */
+void spatial_clear(SpatialIndex *index) {
+  for (int i = 0; i < index->capacity; i++)
+    array_clear(&index->cells[i].items);
+}
+
+unsigned int _cell_hash(int cx, int cy) {
+  return (unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u;
+}
+
+int _cell_coord(SpatialIndex *index, float v) {
+  return (int)floorf(v / index->cell_size);
+}
+
+/* The cell (cx, cy), or NULL if it does not exist and create is false */
+SpatialCell *_get_cell(SpatialIndex *index, int cx, int cy, bool create) {
+  unsigned int mask = index->capacity - 1;
+  unsigned int i = _cell_hash(cx, cy) & mask;
+  for (; index->cells[i].used; i = (i + 1) & mask) {
+    if (index->cells[i].cx == cx && index->cells[i].cy == cy)
+      return &index->cells[i];
+  }
+  if (!create)
+    return NULL;
+
+  // Keep the table at most half full
+  if (2 * (index->cell_count + 1) > index->capacity) {
+    SpatialCell *old = index->cells;
+    int old_capacity = index->capacity;
+    index->capacity *= 2;
+    index->cells = calloc(index->capacity, sizeof(SpatialCell));
+    for (int j = 0; j < old_capacity; j++) {
+      if (!old[j].used)
+        continue;
+      unsigned int k = _cell_hash(old[j].cx, old[j].cy) & (index->capacity - 1);
+      while (index->cells[k].used)
+        k = (k + 1) & (index->capacity - 1);
+      index->cells[k] = old[j];
+    }
+    free(old);
+    return _get_cell(index, cx, cy, true);
+  }
+  index->cells[i].used = true;
+  index->cells[i].cx = cx;
+  index->cells[i].cy = cy;
+  array_init(&index->cells[i].items);
+  index->cell_count++;
+  return &index->cells[i];
+}
+
+void spatial_insert(SpatialIndex *index, int id, float x, float y) {
+  SpatialCell *cell =
+      _get_cell(index, _cell_coord(index, x), _cell_coord(index, y), true);
+  array_add(&cell->items, ((SpatialItem){id, x, y}));
+}
+
+/* Remove item id, last inserted or moved to (x, y) */
+void spatial_remove(SpatialIndex *index, int id, float x, float y) {
+  SpatialCell *cell =
+      _get_cell(index, _cell_coord(index, x), _cell_coord(index, y), false);
+  if (cell == NULL)
+    return;
+  array_enumerate(&cell->items, i, SpatialItem item) {
+    if (item.id == id) {
+      array_del_unordered(&cell->items, i);
+      return;
+    }
+  }
+}
+
+/* Move item id from (x, y) to (new_x, new_y) */
+void spatial_move(SpatialIndex *index, int id, float x, float y, float new_x,
+                  float new_y) {
+  int cx = _cell_coord(index, x), cy = _cell_coord(index, y);
+  if (cx == _cell_coord(index, new_x) && cy == _cell_coord(index, new_y)) {
+    SpatialCell *cell = _get_cell(index, cx, cy, false);
+    if (cell == NULL)
+      return;
+    for (int i = 0; i < array_size(&cell->items); i++) {
+      if (array_at(&cell->items, i).id == id) {
+        array_at(&cell->items, i).x = new_x;
+        array_at(&cell->items, i).y = new_y;
+        return;
+      }
+    }
+    return;
+  }
+  spatial_remove(index, id, x, y);
+  spatial_insert(index, id, new_x, new_y);
+}
+
+/* Append to out the ids of all items inside the rectangle [x0, x1] x [y0, y1] */
+void spatial_query_rect(SpatialIndex *index, float x0, float y0, float x1,
+                        float y1, array_int *out) {
+  int cx0 = _cell_coord(index, x0), cx1 = _cell_coord(index, x1);
+  int cy0 = _cell_coord(index, y0), cy1 = _cell_coord(index, y1);
+  // A huge rectangle is cheaper to answer by scanning every cell
+  if ((long)(cx1 - cx0 + 1) * (cy1 - cy0 + 1) > index->capacity) {
+    for (int i = 0; i < index->capacity; i++) {
+      array_foreach(&index->cells[i].items, SpatialItem item) {
+        if (x0 <= item.x && item.x <= x1 && y0 <= item.y && item.y <= y1)
+          array_add(out, item.id);
+      }
+    }
+    return;
+  }
+  for (int cx = cx0; cx <= cx1; cx++) {
+    for (int cy = cy0; cy <= cy1; cy++) {
+      SpatialCell *cell = _get_cell(index, cx, cy, false);
+      if (cell == NULL)
+        continue;
+      array_foreach(&cell->items, SpatialItem item) {
+        if (x0 <= item.x && item.x <= x1 && y0 <= item.y && item.y <= y1)
+          array_add(out, item.id);
+      }
+    }
+  }
+}
+
+/* Append to out the ids of all items strictly closer than radius to (x, y) */
+void spatial_query_radius(SpatialIndex *index, float x, float y, float radius,
+                          array_int *out) {
+  int cx0 = _cell_coord(index, x - radius), cx1 = _cell_coord(index, x + radius);
+  int cy0 = _cell_coord(index, y - radius), cy1 = _cell_coord(index, y + radius);
+  for (int cx = cx0; cx <= cx1; cx++) {
+    for (int cy = cy0; cy <= cy1; cy++) {
+      SpatialCell *cell = _get_cell(index, cx, cy, false);
+      if (cell == NULL)
+        continue;
+      array_foreach(&cell->items, SpatialItem item) {
+        float dx = item.x - x, dy = item.y - y;
+        if (dx * dx + dy * dy < radius * radius)
+          array_add(out, item.id);
+      }
+    }
+  }
+}
+
+/* Smallest id strictly closer than radius to (x, y), or -1 */
+int spatial_query_point(SpatialIndex *index, float x, float y, float radius) {
+  int cx0 = _cell_coord(index, x - radius), cx1 = _cell_coord(index, x + radius);
+  int cy0 = _cell_coord(index, y - radius), cy1 = _cell_coord(index, y + radius);
+  int best = -1;
+  for (int cx = cx0; cx <= cx1; cx++) {
+    for (int cy = cy0; cy <= cy1; cy++) {
+      SpatialCell *cell = _get_cell(index, cx, cy, false);
+      if (cell == NULL)
+        continue;
+      array_foreach(&cell->items, SpatialItem item) {
+        float dx = item.x - x, dy = item.y - y;
+        if (dx * dx + dy * dy < radius * radius && (best < 0 || item.id < best))
+          best = item.id;
+      }
+    }
+  }
+  return best;
+}
@@ -4,11 +4,45 @@
  */
 #include "array.h"
 #include "matrix.c"
+#include <math.h>
+#include <time.h>
 
-bool graph_changed = false;
-bool stop_flag = false;
-int cur_submap_count = 0;
-int cur_matrix_rows_count = 0;
+// Calls to engine_yield() between two reads of the clock
+#define ENGINE_YIELD_CHECK 64
+
+/* Shared between an engine and the thread that started it: the engine stops as
+soon as cancel is set, and reports its progress in the counters, which the
+render loop polls every frame. */
+typedef struct {
+  volatile bool cancel;
+  volatile int submap_count;
+  volatile int matrix_rows_count;
+  volatile int total_submap_count;
+} EngineRun;
+
+/* Time given to one step of a resumable engine. Engines call engine_yield()
+at their yield points, and return as soon as it says the step is over. */
+typedef struct {
+  double deadline; // In seconds of engine_clock()
+  int calls;
+} EngineBudget;
+
+double engine_clock() {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Budget of a step that runs the engine to the end */
+EngineBudget engine_unbounded() { return (EngineBudget){INFINITY, 0}; }
+
+/* Has the step run out of time? Only reads the clock every
+ENGINE_YIELD_CHECK calls, so yield points may be placed in tight loops. */
+bool engine_yield(EngineBudget *budget) {
+  if (budget->deadline == INFINITY || ++budget->calls % ENGINE_YIELD_CHECK)
+    return false;
+  return engine_clock() >= budget->deadline;
+}
 
 typedef struct {
   int start_idx;
@@ -38,10 +72,6 @@ bool submap_eq(Submap s1, Submap s2) {
          array_eq(&s1.edges, &s2.edges, edge_eq);
 }
 
-// Convenient global variable for recursively generating all submaps using
-// direct_submaps()
-array_submap _all_submaps;
-
 int cmp(const void *a, const void *b) {
   int x = *((int *)a);
   int y = *((int *)b);
@@ -52,77 +82,72 @@ int cmp(const void *a, const void *b) {
   return 0;
 }
 
-array_submap get_direct_submaps(Submap *submap) {
-  array_submap result;
-  array_init(&result);
-
-  array_foreach(&submap->edges, Edge edge) {
-    int i = edge.start_idx;
-    int j = edge.end_idx;
-    // Make sure i < j
-    if (i > j) {
-      int k = i;
-      i = j;
-      j = k;
-    }
+/* The direct submap of submap where the ends of edge are identified */
+Submap get_direct_submap(Submap *submap, Edge edge) {
+  int i = edge.start_idx;
+  int j = edge.end_idx;
+  // Make sure i < j
+  if (i > j) {
+    int k = i;
+    i = j;
+    j = k;
+  }
 
-    array_vertex vertices;
-    array_init(&vertices);
-
-    array_enumerate(&submap->vertices, k, Vertex _) {
-      if (k == i) {
-        Vertex v1 = array_at(&submap->vertices, i);
-        Vertex v2 = array_at(&submap->vertices, j);
-        Vertex identified;
-        array_init(&identified);
-        array_foreach(&v1, int i) { array_add(&identified, i); }
-        array_foreach(&v2, int i) { array_add(&identified, i); }
-        qsort(identified.elems, identified.size, sizeof(int), cmp);
-        array_add(&vertices, identified);
-      } else if (k == j) {
-        continue;
-      } else {
-        Vertex src = array_at(&submap->vertices, k);
-        Vertex dest;
-        array_init(&dest);
-        // Copy over src to dest
-        array_foreach(&src, int i) { array_add(&dest, i); }
-        array_add(&vertices, dest);
-      }
+  array_vertex vertices;
+  array_init(&vertices);
+
+  array_enumerate(&submap->vertices, k, Vertex _) {
+    if (k == i) {
+      Vertex v1 = array_at(&submap->vertices, i);
+      Vertex v2 = array_at(&submap->vertices, j);
+      Vertex identified;
+      array_init(&identified);
+      array_foreach(&v1, int i) { array_add(&identified, i); }
+      array_foreach(&v2, int i) { array_add(&identified, i); }
+      qsort(identified.elems, identified.size, sizeof(int), cmp);
+      array_add(&vertices, identified);
+    } else if (k == j) {
+      continue;
+    } else {
+      Vertex src = array_at(&submap->vertices, k);
+      Vertex dest;
+      array_init(&dest);
+      // Copy over src to dest
+      array_foreach(&src, int i) { array_add(&dest, i); }
+      array_add(&vertices, dest);
     }
+  }
 
-    array_edge edges;
-    array_init(&edges);
+  array_edge edges;
+  array_init(&edges);
 
-    array_foreach(&submap->edges, Edge _edge) {
-      int k = _edge.start_idx;
-      int l = _edge.end_idx;
-      if ((k == i && l == j) || (k == j && l == i)) {
-        continue;
-      }
-      if (k == i || k == j) {
-        if (l > j) {
-          l -= 1;
-        }
-        array_add(&edges, ((l < i) ? (Edge){l, i} : (Edge){i, l}));
-        continue;
-      } else if (l == i || l == j) {
-        if (k > j) {
-          k -= 1;
-        }
-        array_add(&edges, ((k < i) ? (Edge){k, i} : (Edge){i, k}));
-        continue;
+  array_foreach(&submap->edges, Edge _edge) {
+    int k = _edge.start_idx;
+    int l = _edge.end_idx;
+    if ((k == i && l == j) || (k == j && l == i)) {
+      continue;
+    }
+    if (k == i || k == j) {
+      if (l > j) {
+        l -= 1;
       }
-      if (k > j)
+      array_add(&edges, ((l < i) ? (Edge){l, i} : (Edge){i, l}));
+      continue;
+    } else if (l == i || l == j) {
+      if (k > j) {
         k -= 1;
-      if (l > j)
-        l -= 1;
-      array_add(&edges, ((k < l) ? (Edge){k, l} : (Edge){l, k}));
+      }
+      array_add(&edges, ((k < i) ? (Edge){k, i} : (Edge){i, k}));
+      continue;
     }
-
-    array_add(&result, ((Submap){vertices, edges}));
+    if (k > j)
+      k -= 1;
+    if (l > j)
+      l -= 1;
+    array_add(&edges, ((k < l) ? (Edge){k, l} : (Edge){l, k}));
   }
-  return result;
+
+  return (Submap){vertices, edges};
 }
 
 bool in_submap_array(array_submap *submaps, Submap *submap) {
@@ -133,39 +158,6 @@ bool in_submap_array(array_submap *submaps, Submap *submap) {
   return false;
 }
 
-void _handle(Submap *submap) {
-  if (graph_changed || stop_flag) {
-    stop_flag = true;
-    return;
-  }
-
-  bool inside = in_submap_array(&_all_submaps, submap);
-  if (inside) {
-    return;
-  }
-
-  array_submap direct_submaps = get_direct_submaps(submap);
-  if (array_size(&submap->vertices) > 1) {
-    array_foreach(&direct_submaps, Submap direct_submap) {
-      _handle(&direct_submap);
-    }
-  }
-  cur_submap_count++;
-  //idebug(cur_submap_count);
-  array_add(&_all_submaps, ((Submap){submap->vertices, submap->edges}));
-}
-
-array_submap get_all_submaps(Submap *submap) {
-  free_submaps(&_all_submaps);
-  array_init(&_all_submaps);
-  _handle(submap);
-  if (stop_flag)
-    printf("aborted early\n");
-  stop_flag = false;
-  cur_submap_count = 0;
-  return _all_submaps;
-}
-
 Submap from_graph(int n, array_edge edges) {
   array_vertex vertices;
   array_init(&vertices);
@@ -222,40 +214,17 @@ bool submap_ge(Submap *s1, Submap *s2) {
   return true;
 }
 
-WYMatrix get_ordering_matrix(array_submap *submaps) {
-  int size = array_size(submaps);
-  WYMatrix M = matrix_init(size);
-  array_enumerate(submaps, i, Submap s1) {
-    cur_matrix_rows_count++;
-    if (graph_changed || stop_flag) {
-      stop_flag = false;
-      cur_submap_count = 0;
-      cur_matrix_rows_count = 0;
-      return M;
-    }
-    array_enumerate(submaps, j, Submap s2) {
-      bool x = submap_ge(&s2, &s1);
-      if (i <= j && x)
-        M.entries[i][j] = 1;
-      else
-        M.entries[i][j] = 0;
-    }
-  }
-  cur_matrix_rows_count = 0;
-  return M;
-}
-
 /* Compute the last column of the inverse of M.
 This corresponds to the sequence
 (mobius(submap, G) | submap in submaps, G is largest submap) */
-array_int get_mobius_of_column(WYMatrix M) {
-  array_int unknowns;
+array_ll get_mobius_of_column(WYMatrix M) {
+  array_ll unknowns;
   array_init(&unknowns);
   for (int j = M.size - 1; j >= 0; j--) {
     array_add(&unknowns, 0);
   }
 
-  int unknown;
+  long long unknown;
   for (int j = M.size - 1; j >= 0; j--) {
     if (j == M.size - 1)
       unknown = 1;
@@ -271,17 +240,148 @@ array_int get_mobius_of_column(WYMatrix M) {
   return unknowns;
 }
 
-array_int get_chromatic_polynomial(int n, array_submap *submaps, WYMatrix M) {
-  array_int P; // Chromatic polynomial stored as an array of coeffs
+array_ll get_chromatic_polynomial(int n, array_submap *submaps, WYMatrix M) {
+  array_ll P; // Chromatic polynomial stored as an array of coeffs
   array_init(&P);
   for (int i = 0; i < n; i++) {
     array_add(&P, 0); // The size of this array is the no. of nodes in the original graph
   }
-  array_int mobiuses = get_mobius_of_column(M);
-  array_enumerate(&mobiuses, i, int mobius) {
+  array_ll mobiuses = get_mobius_of_column(M);
+  array_enumerate(&mobiuses, i, long long mobius) {
     Submap submap = array_at(submaps, i);
     array_at(&P, array_size(&submap.vertices)-1) += mobius;
   }
   array_term(&mobiuses);
   return P;
-}
\ No newline at end of file
+}
+
+/* A submap whose submaps are being enumerated, and the edge to contract
+next into its next direct submap. Each direct submap is only made when it is
+visited, so that a push costs nothing even on a large graph. */
+typedef struct {
+  Submap submap;
+  int next;
+} SubmapFrame;
+array_def(SubmapFrame, submap_frame);
+
+typedef enum { SUBMAPS_ENUMERATE, SUBMAPS_MATRIX, SUBMAPS_DONE } SubmapPhase;
+
+/*
+ * The submap engine as a sequence of resumable steps: a depth-first
+ * enumeration of all submaps with an explicit stack, then the ordering matrix
+ * one row at a time. Each submap is added after all of its own submaps, as
+ * get_chromatic_polynomial() expects.
+ */
+typedef struct {
+  int n;
+  SubmapPhase phase;
+  bool cancelled;
+  array_submap submaps;
+  array_submap_frame stack;
+  WYMatrix M;
+  int row;
+} SubmapTask;
+
+void _submap_push(SubmapTask *task, Submap submap) {
+  SubmapFrame frame = {submap, 0};
+  array_add(&task->stack, frame);
+}
+
+/* Pop the top frame, keeping its submap in task->submaps if keep is set and
+freeing it otherwise */
+void _submap_pop(SubmapTask *task, bool keep) {
+  SubmapFrame frame = array_last(&task->stack);
+  array_del_last(&task->stack);
+  if (keep)
+    array_add(&task->submaps, frame.submap);
+  else
+    free_submap(&frame.submap);
+}
+
+/* Start computing the chromatic polynomial of the graph with n vertices and
+the given edges */
+void submap_task_start(SubmapTask *task, int n, array_edge *edges) {
+  task->n = n;
+  task->phase = SUBMAPS_ENUMERATE;
+  task->cancelled = false;
+  array_init(&task->submaps);
+  array_init(&task->stack);
+  task->M = (WYMatrix){0, NULL};
+  task->row = 0;
+  _submap_push(task, from_graph(n, *edges));
+}
+
+/* Run the task until it is finished, budget is used up or it moves on to its
+next phase. Returns whether it is finished, which includes being cancelled
+through run. */
+bool submap_task_step(SubmapTask *task, EngineRun *run, EngineBudget *budget) {
+  while (task->phase == SUBMAPS_ENUMERATE) {
+    if (run->cancel) {
+      printf("aborted early\n");
+      while (array_size(&task->stack) > 0)
+        _submap_pop(task, false);
+      task->cancelled = true;
+      task->phase = SUBMAPS_DONE;
+      run->submap_count = 0;
+      return true;
+    }
+    if (array_size(&task->stack) == 0) {
+      run->submap_count = 0;
+      run->total_submap_count = array_size(&task->submaps);
+      task->M = matrix_init(array_size(&task->submaps));
+      task->phase = SUBMAPS_MATRIX;
+      // Return between the phases, so they can be measured apart
+      return false;
+    }
+    if (engine_yield(budget))
+      return false;
+    SubmapFrame *frame = &array_last(&task->stack);
+    if (array_size(&frame->submap.vertices) > 1 &&
+        frame->next < array_size(&frame->submap.edges)) {
+      Submap direct = get_direct_submap(
+          &frame->submap, array_at(&frame->submap.edges, frame->next++));
+      if (in_submap_array(&task->submaps, &direct))
+        free_submap(&direct);
+      else
+        _submap_push(task, direct);
+    } else {
+      run->submap_count++;
+      _submap_pop(task, true);
+    }
+  }
+
+  while (task->phase == SUBMAPS_MATRIX) {
+    int size = array_size(&task->submaps);
+    if (run->cancel || task->row == size) {
+      task->cancelled = run->cancel;
+      task->phase = SUBMAPS_DONE;
+      run->submap_count = 0;
+      run->matrix_rows_count = 0;
+      return true;
+    }
+    if (engine_yield(budget))
+      return false;
+    run->matrix_rows_count++;
+    int i = task->row++;
+    Submap s1 = array_at(&task->submaps, i);
+    array_enumerate(&task->submaps, j, Submap s2) {
+      bool x = submap_ge(&s2, &s1);
+      task->M.entries[i][j] = i <= j && x;
+    }
+  }
+  return true;
+}
+
+/* Free the task, and put the polynomial into P (which must be empty) unless
+it was cancelled. Returns whether it was not. */
+bool submap_task_finish(SubmapTask *task, array_ll *P) {
+  bool done = task->phase == SUBMAPS_DONE && !task->cancelled;
+  if (done)
+    *P = get_chromatic_polynomial(task->n, &task->submaps, task->M);
+  while (array_size(&task->stack) > 0)
+    _submap_pop(task, false);
+  array_term(&task->stack);
+  matrix_free(task->M);
+  free_submaps(&task->submaps);
+  return done;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * Timeline of what the threads do, written as Chrome trace JSON, which
+ * Perfetto (ui.perfetto.dev) and chrome://tracing open:
+ *
+ *   TRACE_BEGIN("frame");
+ *   ...
+ *   TRACE_END("frame");
+ *   TRACE_INSTANT("cancel", job->id);
+ *
+ * Each thread records into its own ring buffer, which it alone writes, so
+ * recording takes no lock: the buffer publishes how far it has been written
+ * with an atomic counter, and trace_write() copies what it sees from any
+ * thread. When a buffer wraps around, its oldest events are dropped, which
+ * may leave a scope without its beginning.
+ * Names must be string literals (or other strings that live forever) without
+ * characters that need escaping in JSON.
+ *
+ * Recording only happens if CHROMPOLY_TRACE names the file to write, and like
+ * the debug.h macros, everything compiles to nothing under NDEBUG.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef NDEBUG
+
+#define TRACE_INIT() ((void)0)
+#define TRACE_THREAD(name) ((void)0)
+#define TRACE_BEGIN(name) ((void)(name))
+#define TRACE_END(name) ((void)(name))
+#define TRACE_INSTANT(name, value) ((void)0)
+#define TRACE_WRITE() ((void)0)
+#define TRACE_TERM() ((void)0)
+
+#else
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#define TRACE_CAPACITY (1 << 16) // Events kept per thread
+#define TRACE_MAX_THREADS 256
+
+typedef struct {
+  const char *name;
+  char phase;      // 'B'egin, 'E'nd or 'i'nstant, as in the JSON
+  long long value; // Argument of instant events
+  long long time;  // Nanoseconds since trace_init()
+} TraceEvent;
+
+typedef struct {
+  const char *name; // Of the thread
+  int tid;
+  atomic_ullong written; // Events ever written, the last TRACE_CAPACITY kept
+  TraceEvent events[TRACE_CAPACITY];
+} TraceBuffer;
+
+const char *trace_path = NULL; // NULL when not recording
+long long trace_epoch;
+mtx_t trace_mutex; // Guards trace_buffers and writing the file
+TraceBuffer *trace_buffers[TRACE_MAX_THREADS];
+int trace_thread_count = 0;
+
+_Thread_local TraceBuffer *trace_buffer = NULL;
+_Thread_local const char *trace_thread_name = "thread";
+
+long long _trace_now() {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec - trace_epoch;
+}
+
+void trace_init() {
+  trace_path = getenv("CHROMPOLY_TRACE");
+  if (trace_path == NULL)
+    return;
+  mtx_init(&trace_mutex, mtx_plain);
+  trace_epoch = 0;
+  trace_epoch = _trace_now();
+}
+
+/* Name the calling thread on the timeline. Call before it records events. */
+void trace_thread(const char *name) { trace_thread_name = name; }
+
+/* The buffer of the calling thread, created the first time it records */
+TraceBuffer *_trace_buffer() {
+  if (trace_buffer != NULL)
+    return trace_buffer;
+  TraceBuffer *buffer = calloc(1, sizeof(TraceBuffer));
+  if (buffer == NULL)
+    return NULL;
+  buffer->name = trace_thread_name;
+  mtx_lock(&trace_mutex);
+  if (trace_thread_count < TRACE_MAX_THREADS) {
+    buffer->tid = trace_thread_count + 1;
+    trace_buffers[trace_thread_count++] = buffer;
+    trace_buffer = buffer;
+  } else {
+    free(buffer);
+  }
+  mtx_unlock(&trace_mutex);
+  return trace_buffer;
+}
+
+void trace_event(const char *name, char phase, long long value) {
+  if (trace_path == NULL)
+    return;
+  TraceBuffer *buffer = _trace_buffer();
+  if (buffer == NULL)
+    return;
+  unsigned long long n =
+      atomic_load_explicit(&buffer->written, memory_order_relaxed);
+  buffer->events[n % TRACE_CAPACITY] =
+      (TraceEvent){name, phase, value, _trace_now()};
+  atomic_store_explicit(&buffer->written, n + 1, memory_order_release);
+}
+
+void _trace_write_event(FILE *out, TraceBuffer *buffer, TraceEvent *event) {
+  fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,"
+               "\"ts\":%.3f",
+          event->name, event->phase, buffer->tid, event->time / 1e3);
+  if (event->phase == 'i')
+    fprintf(out, ",\"s\":\"t\",\"args\":{\"value\":%lld}", event->value);
+  fprintf(out, "}");
+}
+
+/* Write the events of all threads to the trace file, replacing it. Events
+that are overwritten while they are being copied are left out. */
+void trace_write() {
+  if (trace_path == NULL)
+    return;
+  mtx_lock(&trace_mutex);
+  FILE *out = fopen(trace_path, "w");
+  if (out == NULL) {
+    printf("Failed to write the trace to %s\n", trace_path);
+    mtx_unlock(&trace_mutex);
+    return;
+  }
+  fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+               "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"args\":{\"name\":\"chrompoly\"}}");
+  TraceEvent *events = malloc(TRACE_CAPACITY * sizeof(TraceEvent));
+  for (int t = 0; t < trace_thread_count && events != NULL; t++) {
+    TraceBuffer *buffer = trace_buffers[t];
+    fprintf(out,
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}",
+            buffer->tid, buffer->name);
+    // Copy the events, then keep those that were not overwritten meanwhile
+    unsigned long long end =
+        atomic_load_explicit(&buffer->written, memory_order_acquire);
+    unsigned long long start = end > TRACE_CAPACITY ? end - TRACE_CAPACITY : 0;
+    for (unsigned long long i = start; i < end; i++)
+      events[i % TRACE_CAPACITY] = buffer->events[i % TRACE_CAPACITY];
+    atomic_thread_fence(memory_order_acquire);
+    unsigned long long now =
+        atomic_load_explicit(&buffer->written, memory_order_relaxed);
+    // Writing event i overwrites event i - TRACE_CAPACITY, and event now may
+    // be being written
+    if (now >= TRACE_CAPACITY && now - TRACE_CAPACITY + 1 > start)
+      start = now - TRACE_CAPACITY + 1;
+    for (unsigned long long i = start; i < end; i++)
+      _trace_write_event(out, buffer, &events[i % TRACE_CAPACITY]);
+  }
+  free(events);
+  fprintf(out, "\n]}\n");
+  fclose(out);
+  printf("Wrote the trace to %s\n", trace_path);
+  mtx_unlock(&trace_mutex);
+}
+
+/* Free the buffers. No thread may record events anymore. */
+void trace_term() {
+  if (trace_path == NULL)
+    return;
+  for (int t = 0; t < trace_thread_count; t++)
+    free(trace_buffers[t]);
+  trace_thread_count = 0;
+  trace_path = NULL;
+}
+
+#define TRACE_INIT() trace_init()
+#define TRACE_THREAD(name) trace_thread(name)
+#define TRACE_BEGIN(name) trace_event(name, 'B', 0)
+#define TRACE_END(name) trace_event(name, 'E', 0)
+#define TRACE_INSTANT(name, value) trace_event(name, 'i', value)
+#define TRACE_WRITE() trace_write()
+#define TRACE_TERM() trace_term()
+
+#endif /* NDEBUG */
+
+#endif /* TRACE_H */
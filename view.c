@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2023-2023 Way Yan Win
+ * This code is under the MIT License.
+ *
+ * The camera through which the canvas is seen.
+ * Scrolling zooms around the mouse, dragging with the middle button pans, and
+ * Home resets the view. The zoom also picks how much detail is drawn:
+ * - detail: every visible node is drawn as an animated circle,
+ * - batched: nodes and edges come from the batched renderer,
+ * - points: nodes are drawn as points, edges between the same two areas of
+ *   the screen are merged into one line, and animations are not shown.
+ */
+#include "raylib/raylib.h"
+#include <math.h>
+
+#define MIN_ZOOM 0.02
+#define MAX_ZOOM 8.0
+#define ZOOM_STEP 1.15 // Zoom factor per wheel notch
+#define LOD_BATCHED_ZOOM 0.5
+#define LOD_POINTS_ZOOM 0.15
+
+typedef enum { LOD_DETAIL, LOD_BATCHED, LOD_POINTS } LevelOfDetail;
+
+typedef struct {
+  Camera2D camera;
+} View;
+
+void view_init(View *view) { view->camera = (Camera2D){.zoom = 1.0}; }
+
+/* Center the canvas rectangle bounds in a width x height window, zoomed out
+far enough to show all of it */
+void view_fit(View *view, Rectangle bounds, int width, int height) {
+  float zoom = fminf(width / bounds.width, height / bounds.height);
+  view->camera.zoom = fmaxf(MIN_ZOOM, fminf(1.0, zoom));
+  view->camera.offset = (Vector2){width / 2.0, height / 2.0};
+  view->camera.target = (Vector2){bounds.x + bounds.width / 2,
+                                  bounds.y + bounds.height / 2};
+}
+
+/* Handle the zoom and pan input of this frame. The mouse wheel only zooms if
+zoom is set, so that it can scroll what is drawn over the canvas instead. */
+void view_update(View *view, bool zoom) {
+  Camera2D *camera = &view->camera;
+  if (IsKeyPressed(KEY_HOME))
+    view_init(view);
+
+  float wheel = zoom ? GetMouseWheelMove() : 0;
+  if (wheel != 0) {
+    // Keep the point under the mouse in place
+    Vector2 mouse = GetMousePosition();
+    Vector2 anchor = GetScreenToWorld2D(mouse, *camera);
+    camera->zoom *= powf(ZOOM_STEP, wheel);
+    if (camera->zoom < MIN_ZOOM)
+      camera->zoom = MIN_ZOOM;
+    if (camera->zoom > MAX_ZOOM)
+      camera->zoom = MAX_ZOOM;
+    camera->offset = mouse;
+    camera->target = anchor;
+  }
+
+  if (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
+    Vector2 delta = GetMouseDelta();
+    camera->target.x -= delta.x / camera->zoom;
+    camera->target.y -= delta.y / camera->zoom;
+  }
+}
+
+/* The mouse position in canvas coordinates */
+Vector2 view_mouse(View *view) {
+  return GetScreenToWorld2D(GetMousePosition(), view->camera);
+}
+
+/* The part of the canvas visible in a width x height window */
+Rectangle view_visible_rect(View *view, int width, int height) {
+  Vector2 a = GetScreenToWorld2D((Vector2){0, 0}, view->camera);
+  Vector2 b = GetScreenToWorld2D((Vector2){width, height}, view->camera);
+  return (Rectangle){a.x, a.y, b.x - a.x, b.y - a.y};
+}
+
+LevelOfDetail view_lod(View *view) {
+  if (view->camera.zoom < LOD_POINTS_ZOOM)
+    return LOD_POINTS;
+  if (view->camera.zoom < LOD_BATCHED_ZOOM)
+    return LOD_BATCHED;
+  return LOD_DETAIL;
+}